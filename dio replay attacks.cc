@@ -3,6 +3,27 @@
    - Flooding attacker that shares LR-WPAN medium
    - MAC-level filtering to actually prevent flooding
    - Downward traffic includes timestamp => real avg delay
+   - Optional triggered pcap capture around block / PDR-drop events
+   - Optional IP-layer per-flow statistics (FlowMonitor, IPv6 classifier)
+   - Scheduled node failures / reboots (optionally with a fresh address)
+   - Optional mobility: random-waypoint subset, vehicle paths, mobile attacker
+   - Selectable path loss / shadowing / fading, background interferers, link PRR
+   - Optional multi-channel operation (one PAN per channel, multi-radio root)
+   - Optional RPL-like control plane: trickle DIOs, MAC-ACK ETX, MRHOF parents
+   - Multiple DODAG roots with load-driven failover
+   - Optional backhaul (p2p / CSMA) to a local server hosting the sender
+   - Downward routes in storing or non-storing mode, optional forged-DAO flood
+   - Compact root route table (sorted by interface ID) with a micro-benchmark
+   - Optional DAO aggregation at storing-mode parents
+   - DIO version-number and rank attacks, global-repair and outage metrics
+   - DIS flood attacker and per-neighbour DIS rate limiting
+   - Provisioned allowlist fast path in the Mitigator with sampled checks
+   - Source address validation (link-layer sender to IPv6 source binding)
+   - Optional AES-CCM link-layer security cost model (bytes, latency, energy)
+   - Blocked-attacker localization from forwarder SINR and hop count
+   - Ground-truth labels on attack packets and a detector confusion matrix
+   - Partitioned multi-PAN runs over MPI (one PAN per rank, p2p backhaul)
+   - Sharded metrics, merged on rank 0 into the usual CSVs
 */
 
 #include "ns3/core-module.h"
@@ -14,14 +35,32 @@
 #include "ns3/sixlowpan-module.h"
 #include "ns3/lr-wpan-net-device.h"
 #include "ns3/lr-wpan-mac.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/spectrum-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/csma-module.h"
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include <mpi.h>
+#endif
 
 #include <filesystem>
 #include <fstream>
 #include <deque>
 #include <map>
 #include <set>
+#include <unordered_set>
+#include <unordered_map>
 #include <cmath>
+#include <limits>
 #include <algorithm>
+#include <array>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <type_traits>
 
 using namespace ns3;
 using namespace ns3::lrwpan;
@@ -31,21 +70,292 @@ NS_LOG_COMPONENT_DEFINE("RplDaoMitigationFull");
 struct PayloadHdr {
   uint32_t seq;
   double txTime;
+  uint8_t type;
 } __attribute__((packed));
 
+// PayloadHdr::type, CoAP-like message types
+enum : uint8_t { kMsgNon = 0, kMsgCon = 1, kMsgAck = 2 };
+
 // Global state for MAC-level filtering
 static std::set<Ipv6Address> g_blockedSources;
 static bool g_mitigationEnabled = false;
 
+// ---------------- LogHistogram ----------------
+// Fixed-size log-spaced histogram (5% bins from 1 us) for streaming
+// percentiles of small time values without storing samples.
+class LogHistogram {
+public:
+  static constexpr double kMin = 1e-6;
+  static constexpr double kGrowth = 1.05;
+  static constexpr uint32_t kBins = 340;
+
+  void Add(double v) {
+    uint32_t b = 0;
+    if (v > kMin) b = std::min(kBins - 1, 1 + static_cast<uint32_t>(std::log(v / kMin) / std::log(kGrowth)));
+    m_bins[b]++;
+    m_n++;
+  }
+  void Merge(const LogHistogram &o) {
+    for (uint32_t i = 0; i < kBins; ++i) m_bins[i] += o.m_bins[i];
+    m_n += o.m_n;
+  }
+  // Upper edge of the bin holding the q-quantile.
+  double Quantile(double q) const {
+    if (m_n == 0) return 0.0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(m_n)));
+    uint64_t acc = 0;
+    for (uint32_t i = 0; i < kBins; ++i) {
+      acc += m_bins[i];
+      if (acc >= rank && acc > 0) return kMin * std::pow(kGrowth, static_cast<double>(i));
+    }
+    return kMin * std::pow(kGrowth, static_cast<double>(kBins - 1));
+  }
+  uint64_t Count() const { return m_n; }
+
+private:
+  std::array<uint64_t, kBins> m_bins{};
+  uint64_t m_n{0};
+};
+
+// ---------------- Shard archives ----------------
+// Flat byte image of a metrics shard, so partitions in other processes can
+// ship their counters to the one writing the CSVs. Both directions walk the
+// same field list; structs that are not trivially copyable list their
+// fields in an Io(archive) member.
+class ShardWriter {
+public:
+  template <typename T> void Io(const T &v) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      const uint8_t *p = reinterpret_cast<const uint8_t*>(&v);
+      m_buf.insert(m_buf.end(), p, p + sizeof(T));
+    } else {
+      const_cast<T&>(v).Io(*this);
+    }
+  }
+  void Io(const Time &t) { Io(t.GetTimeStep()); }
+  void Io(const Ipv6Address &a) { uint8_t b[16]; a.Serialize(b); Io(b); }
+  void Io(const std::string &s) { Io(static_cast<uint64_t>(s.size())); m_buf.insert(m_buf.end(), s.begin(), s.end()); }
+  template <typename A, typename B> void Io(const std::pair<A, B> &v) { Io(v.first); Io(v.second); }
+  template <typename K, typename V> void Io(const std::map<K, V> &m) {
+    Io(static_cast<uint64_t>(m.size()));
+    for (const auto &kv : m) { Io(kv.first); Io(kv.second); }
+  }
+  template <typename T> void Io(const std::vector<T> &v) {
+    Io(static_cast<uint64_t>(v.size()));
+    for (const T &x : v) Io(x);
+  }
+  std::vector<uint8_t> Take() { return std::move(m_buf); }
+
+private:
+  std::vector<uint8_t> m_buf;
+};
+
+class ShardReader {
+public:
+  explicit ShardReader(const std::vector<uint8_t> &buf) : m_buf(buf) {}
+  template <typename T> void Io(T &v) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      NS_ABORT_MSG_IF(m_pos + sizeof(T) > m_buf.size(), "Truncated metrics shard");
+      std::memcpy(&v, m_buf.data() + m_pos, sizeof(T));
+      m_pos += sizeof(T);
+    } else {
+      v.Io(*this);
+    }
+  }
+  void Io(Time &t) { int64_t ts = 0; Io(ts); t = TimeStep(ts); }
+  void Io(Ipv6Address &a) { uint8_t b[16]; Io(b); a = Ipv6Address::Deserialize(b); }
+  void Io(std::string &s) {
+    uint64_t n = 0; Io(n);
+    NS_ABORT_MSG_IF(m_pos + n > m_buf.size(), "Truncated metrics shard");
+    s.assign(m_buf.begin() + m_pos, m_buf.begin() + m_pos + n);
+    m_pos += n;
+  }
+  template <typename A, typename B> void Io(std::pair<A, B> &v) { Io(v.first); Io(v.second); }
+  template <typename K, typename V> void Io(std::map<K, V> &m) {
+    uint64_t n = 0; Io(n);
+    m.clear();
+    for (uint64_t k = 0; k < n; ++k) { std::pair<K, V> kv; Io(kv); m.insert(std::move(kv)); }
+  }
+  template <typename T> void Io(std::vector<T> &v) {
+    uint64_t n = 0; Io(n);
+    v.assign(n, T());
+    for (T &x : v) Io(x);
+  }
+
+private:
+  const std::vector<uint8_t> &m_buf;
+  size_t m_pos{0};
+};
+
 // ---------------- MetricsCollector ----------------
+// One collector is one shard: applications only ever touch the collector of
+// their own partition, so nothing is shared while the simulation runs.
+// Shards are folded together with Merge before the CSVs are written.
 class MetricsCollector {
 public:
   MetricsCollector() = default;
   void NoteTxPacket(Ptr<const Packet>) { m_totalTx++; }
   void NoteRxPacket(Ptr<const Packet>, Time delay) { m_totalRx++; m_sumDelay += delay; }
   void NoteControlTx() { m_controlTx++; }
-  void NoteControlRx() { m_controlRx++; }
-  void NoteControlDropped() { m_controlDropped++; }
+  // Detector verdicts on control packets, split by their ground-truth label.
+  void NoteControlRx(bool attack) { m_controlRx++; (attack ? m_fn : m_tn)++; }
+  void NoteControlDropped(bool attack) { m_controlDropped++; (attack ? m_tp : m_fp)++; }
+  // Attack packets a blocked sender held back instead of sending.
+  void NoteControlSuppressed() { m_controlSuppressed++; }
+  void SetDetectorConfig(uint32_t threshold, double windowSec) { m_threshold = threshold; m_windowSec = windowSec; }
+  // RFC 3550 interarrival jitter and |IPDV| sample for one downward flow.
+  void NoteJitter(uint32_t sinkNode, const Ipv6Address &src, Time jitter, Time ipdv) {
+    JitterStats &js = m_jitter[{sinkNode, src}];
+    js.jitter = jitter;
+    js.maxJitter = std::max(js.maxJitter, jitter);
+    js.ipdv.Add(ipdv.GetSeconds());
+  }
+  void NoteConfirmableDone(Time firstTx, Time latency, uint32_t bytes) {
+    if (m_conDone == 0 || firstTx < m_conFirstTx) m_conFirstTx = firstTx;
+    m_conLastAck = Simulator::Now();
+    m_conDone++;
+    m_conBytes += bytes;
+    m_conLatencySum += latency;
+    m_conLatency.Add(latency.GetSeconds());
+  }
+  void NoteConfirmableFailed() { m_conFailed++; }
+  void NoteRetransmission(uint32_t bytes) { m_retx++; m_retxBytes += bytes; }
+  void NoteDetectorState(size_t entries, uint32_t purged) {
+    m_peakDetectorState = std::max<uint64_t>(m_peakDetectorState, entries);
+    m_detectorPurged += purged;
+  }
+  // Allowlisted packets: skipped detection, sampled into it, or the source
+  // lost its allowlist entry after a sampled block.
+  void NoteAllowlist(bool sampled, bool revoked) {
+    if (sampled) m_allowSampled++; else m_allowFast++;
+    if (revoked) m_allowRevoked++;
+  }
+  void NoteSaviCheck(bool spoofed) { m_saviChecked++; if (spoofed) m_saviSpoofed++; }
+  void NoteSaviDrop() { m_saviDropped++; }
+  void NoteRplTx(uint8_t type, uint32_t bytes) { m_rplTx[type]++; m_rplTxBytes += bytes; }
+  void NoteRouting(uint32_t node, int32_t parent, uint16_t rank, uint32_t switches, uint32_t neighbours,
+                   const Ipv6Address &dodag) {
+    m_routing[node] = {parent, rank, switches, neighbours, dodag};
+  }
+  void NoteRootAddress(uint32_t root, const Ipv6Address &addr) { m_rootOf[addr] = root; m_roots[root]; }
+  // One sample per second of packets received at a root's IPv6 layer.
+  void NoteRootLoad(uint32_t root, uint64_t pkts, bool saturated, bool enteredSaturation) {
+    RootLoad &rl = m_roots[root];
+    rl.rx += pkts;
+    rl.peakPps = std::max(rl.peakPps, pkts);
+    if (saturated) rl.saturatedSec++;
+    if (enteredSaturation) rl.failovers++;
+  }
+  // Packets a border router forwards, split by egress (backhaul or radio).
+  void NoteBorderForward(uint32_t root, bool toBackhaul) {
+    BorderStats &b = m_border[root];
+    if (toBackhaul) b.up++; else b.down++;
+  }
+  void NoteBorderDrop(uint32_t root) { m_border[root].dropped++; }
+  void SetRouteMode(const std::string &mode) { m_routeMode = mode; }
+  // One DAO sent; each extra target rode along instead of paying headerBytes
+  // (DAO base, UDP and IPv6 headers) in a DAO of its own.
+  void NoteDaoTx(uint32_t targets, uint32_t headerBytes) {
+    m_daoMsgs++;
+    m_daoTargets += targets;
+    m_daoBytesSaved += static_cast<uint64_t>(targets - 1) * headerBytes;
+  }
+  // Downward route table size of one node after a change.
+  void NoteRouteTable(uint32_t node, size_t entries, size_t bytes) {
+    RouteTable &t = m_tables[node];
+    t.entries = entries;
+    t.peakEntries = std::max<uint64_t>(t.peakEntries, entries);
+    t.peakBytes = std::max<uint64_t>(t.peakBytes, bytes);
+  }
+  // One downward packet leaving a non-storing root.
+  void NoteSourceRoute(uint32_t hops, uint32_t srhBytes, uint32_t lookups, double lookupNs) {
+    m_srPkts++;
+    m_srHops += hops;
+    m_srBytes += srhBytes;
+    m_srLookups += lookups;
+    m_srLookupNs += lookupNs;
+  }
+  // A DODAG version change: started by a root, or adopted by a node.
+  void NoteRepair(bool byRoot) { if (byRoot) m_rootRepairs++; else m_nodeRepairs++; }
+  void NoteDisRx(bool limited, bool resetTrickle) {
+    m_disRx++;
+    if (limited) m_disLimited++;
+    if (resetTrickle) m_disResets++;
+  }
+  // The one interval-PDR sampler: every interval it hands the data tx/rx
+  // deltas to the subscribers and, once WatchOutage was called, to the
+  // outage series. The first caller fixes the interval.
+  void SampleDelivery(Time interval) {
+    if (m_sampling) return;
+    m_sampling = true;
+    m_outageInterval = interval;
+    m_outageLastTx = m_totalTx; m_outageLastRx = m_totalRx;
+    Simulator::Schedule(interval, &MetricsCollector::CheckDelivery, this);
+  }
+  void OnDeliveryInterval(Callback<void, uint64_t, uint64_t> cb) { m_deliveryWatchers.push_back(cb); }
+  // Count intervals whose delivery ratio is below floor as data-plane outage.
+  void WatchOutage(Time interval, double floor) {
+    m_outageFloor = floor;
+    m_outageOn = true;
+    SampleDelivery(interval);
+  }
+
+  std::vector<uint8_t> Pack() {
+    ShardWriter w;
+    Visit(w);
+    return w.Take();
+  }
+  void Unpack(const std::vector<uint8_t> &buf) {
+    ShardReader r(buf);
+    Visit(r);
+  }
+
+  // Adds another shard: counters sum, peaks take the maximum, per-node and
+  // per-flow state is disjoint between partitions and is copied over.
+  void Merge(const MetricsCollector &o) {
+    m_totalTx += o.m_totalTx; m_totalRx += o.m_totalRx; m_sumDelay += o.m_sumDelay;
+    m_controlTx += o.m_controlTx; m_controlRx += o.m_controlRx;
+    m_controlDropped += o.m_controlDropped; m_controlSuppressed += o.m_controlSuppressed;
+    m_tp += o.m_tp; m_fp += o.m_fp; m_tn += o.m_tn; m_fn += o.m_fn;
+    m_jitter.insert(o.m_jitter.begin(), o.m_jitter.end());
+    if (o.m_conDone > 0 && (m_conDone == 0 || o.m_conFirstTx < m_conFirstTx)) m_conFirstTx = o.m_conFirstTx;
+    m_conLastAck = std::max(m_conLastAck, o.m_conLastAck);
+    m_conDone += o.m_conDone; m_conFailed += o.m_conFailed; m_conBytes += o.m_conBytes;
+    m_conLatencySum += o.m_conLatencySum;
+    m_conLatency.Merge(o.m_conLatency);
+    m_retx += o.m_retx; m_retxBytes += o.m_retxBytes;
+    m_routing.insert(o.m_routing.begin(), o.m_routing.end());
+    for (const auto &kv : o.m_roots) {
+      RootLoad &rl = m_roots[kv.first];
+      rl.rx += kv.second.rx;
+      rl.peakPps = std::max(rl.peakPps, kv.second.peakPps);
+      rl.saturatedSec += kv.second.saturatedSec;
+      rl.failovers += kv.second.failovers;
+    }
+    m_rootOf.insert(o.m_rootOf.begin(), o.m_rootOf.end());
+    for (const auto &kv : o.m_border) {
+      BorderStats &b = m_border[kv.first];
+      b.up += kv.second.up; b.down += kv.second.down; b.dropped += kv.second.dropped;
+    }
+    if (m_routeMode.empty()) m_routeMode = o.m_routeMode;
+    m_disRx += o.m_disRx; m_disLimited += o.m_disLimited; m_disResets += o.m_disResets;
+    m_rootRepairs += o.m_rootRepairs; m_nodeRepairs += o.m_nodeRepairs;
+    if (m_outageTx.size() < o.m_outageTx.size()) {
+      m_outageTx.resize(o.m_outageTx.size(), 0);
+      m_outageRx.resize(o.m_outageRx.size(), 0);
+    }
+    for (size_t k = 0; k < o.m_outageTx.size(); ++k) { m_outageTx[k] += o.m_outageTx[k]; m_outageRx[k] += o.m_outageRx[k]; }
+    m_daoMsgs += o.m_daoMsgs; m_daoTargets += o.m_daoTargets; m_daoBytesSaved += o.m_daoBytesSaved;
+    m_tables.insert(o.m_tables.begin(), o.m_tables.end());
+    m_srPkts += o.m_srPkts; m_srHops += o.m_srHops; m_srBytes += o.m_srBytes;
+    m_srLookups += o.m_srLookups; m_srLookupNs += o.m_srLookupNs;
+    for (size_t k = 0; k < m_rplTx.size(); ++k) m_rplTx[k] += o.m_rplTx[k];
+    m_rplTxBytes += o.m_rplTxBytes;
+    m_peakDetectorState = std::max(m_peakDetectorState, o.m_peakDetectorState);
+    m_detectorPurged += o.m_detectorPurged;
+    m_saviChecked += o.m_saviChecked; m_saviSpoofed += o.m_saviSpoofed; m_saviDropped += o.m_saviDropped;
+    m_allowFast += o.m_allowFast; m_allowSampled += o.m_allowSampled; m_allowRevoked += o.m_allowRevoked;
+  }
 
   void WriteCsv(const std::string &prefix) {
     std::filesystem::create_directories("results");
@@ -66,17 +376,664 @@ public:
       f << "control_tx,control_rx,control_dropped\n";
       f << m_controlTx << "," << m_controlRx << "," << m_controlDropped << "\n";
     }
+    {
+      // One ROC point per run; output.py sweeps threshold to trace the curve.
+      std::ofstream f("results/" + prefix + "_detection.csv");
+      auto ratio = [](uint64_t a, uint64_t b) { return (b > 0) ? static_cast<double>(a) / static_cast<double>(b) : 0.0; };
+      f << "threshold,window_s,tp,fp,tn,fn,suppressed,tpr,fpr,precision,accuracy\n";
+      f << m_threshold << "," << m_windowSec << "," << m_tp << "," << m_fp << "," << m_tn << "," << m_fn << ","
+        << m_controlSuppressed << "," << ratio(m_tp, m_tp + m_fn) << "," << ratio(m_fp, m_fp + m_tn) << ","
+        << ratio(m_tp, m_tp + m_fp) << "," << ratio(m_tp + m_tn, m_tp + m_fp + m_tn + m_fn) << "\n";
+    }
+    {
+      std::ofstream f("results/" + prefix + "_detector.csv");
+      f << "peak_sources,purged_sources,fast_path,sampled,revoked\n";
+      f << m_peakDetectorState << "," << m_detectorPurged << "," << m_allowFast << "," << m_allowSampled << ","
+        << m_allowRevoked << "\n";
+    }
+    {
+      std::ofstream f("results/" + prefix + "_jitter.csv");
+      f << "sink,src,samples,jitter_s,max_jitter_s,ipdv_p50_s,ipdv_p95_s,ipdv_p99_s\n";
+      LogHistogram all;
+      Time sumJitter{Seconds(0)};
+      for (const auto &kv : m_jitter) {
+        const JitterStats &js = kv.second;
+        f << kv.first.first << "," << kv.first.second << "," << js.ipdv.Count() << ","
+          << js.jitter.GetSeconds() << "," << js.maxJitter.GetSeconds() << ","
+          << js.ipdv.Quantile(0.5) << "," << js.ipdv.Quantile(0.95) << "," << js.ipdv.Quantile(0.99) << "\n";
+        all.Merge(js.ipdv);
+        sumJitter += js.jitter;
+      }
+      double meanJitter = m_jitter.empty() ? 0.0 : sumJitter.GetSeconds() / static_cast<double>(m_jitter.size());
+      f << "all,," << all.Count() << "," << meanJitter << ",,"
+        << all.Quantile(0.5) << "," << all.Quantile(0.95) << "," << all.Quantile(0.99) << "\n";
+    }
+    if (!m_routing.empty()) {
+      std::ofstream f("results/" + prefix + "_routing.csv");
+      f << "node,parent,rank,path_etx,parent_switches,neighbours,root\n";
+      std::map<uint32_t, uint32_t> members;
+      for (const auto &kv : m_routing) {
+        const RouteInfo &r = kv.second;
+        auto root = m_rootOf.find(r.dodag);
+        int32_t rootId = (r.parent >= 0 && root != m_rootOf.end()) ? static_cast<int32_t>(root->second) : -1;
+        if (rootId >= 0) members[rootId]++;
+        f << kv.first << "," << r.parent << "," << r.rank << "," << r.rank / 128.0 - 1.0 << ","
+          << r.switches << "," << r.neighbours << "," << rootId << "\n";
+      }
+      std::ofstream h("results/" + prefix + "_roots.csv");
+      h << "root,members,rx_pkts,peak_pps,saturated_s,failovers\n";
+      for (const auto &kv : m_roots) {
+        const RootLoad &rl = kv.second;
+        h << kv.first << "," << members[kv.first] << "," << rl.rx << "," << rl.peakPps << ","
+          << rl.saturatedSec << "," << rl.failovers << "\n";
+      }
+      std::ofstream g("results/" + prefix + "_rpl_overhead.csv");
+      g << "dis_tx,dio_tx,dao_tx,bytes\n";
+      g << m_rplTx[0] << "," << m_rplTx[1] << "," << m_rplTx[2] << "," << m_rplTxBytes << "\n";
+      std::ofstream ds("results/" + prefix + "_dis.csv");
+      ds << "dis_rx,dis_limited,trickle_resets\n";
+      ds << m_disRx << "," << m_disLimited << "," << m_disResets << "\n";
+      std::ofstream rp("results/" + prefix + "_repair.csv");
+      rp << "root_repairs,node_repairs,outage_s,observed_s\n";
+      uint64_t samples = 0, outages = 0;
+      for (size_t k = 0; k < m_outageTx.size(); ++k) {
+        if (m_outageTx[k] == 0) continue;
+        samples++;
+        if (static_cast<double>(m_outageRx[k]) / static_cast<double>(m_outageTx[k]) < m_outageFloor) outages++;
+      }
+      rp << m_rootRepairs << "," << m_nodeRepairs << "," << outages * m_outageInterval.GetSeconds() << ","
+         << samples * m_outageInterval.GetSeconds() << "\n";
+    }
+    if (m_saviChecked > 0) {
+      std::ofstream f("results/" + prefix + "_savi.csv");
+      f << "checked,spoofed,dropped_at_mitigator\n";
+      f << m_saviChecked << "," << m_saviSpoofed << "," << m_saviDropped << "\n";
+    }
+    if (!m_border.empty()) {
+      std::ofstream f("results/" + prefix + "_backhaul.csv");
+      f << "root,fwd_to_backhaul,fwd_to_radio,dropped\n";
+      for (const auto &kv : m_border) {
+        f << kv.first << "," << kv.second.up << "," << kv.second.down << "," << kv.second.dropped << "\n";
+      }
+    }
+    if (!m_tables.empty()) {
+      std::ofstream f("results/" + prefix + "_route_state.csv");
+      f << "node,mode,entries,peak_entries,peak_bytes\n";
+      for (const auto &kv : m_tables) {
+        f << kv.first << "," << m_routeMode << "," << kv.second.entries << "," << kv.second.peakEntries << ","
+          << kv.second.peakBytes << "\n";
+      }
+    }
+    if (m_daoMsgs > 0) {
+      std::ofstream f("results/" + prefix + "_dao_agg.csv");
+      f << "dao_msgs,dao_targets,targets_per_msg,msgs_saved,bytes_saved\n";
+      f << m_daoMsgs << "," << m_daoTargets << "," << static_cast<double>(m_daoTargets) / m_daoMsgs << ","
+        << m_daoTargets - m_daoMsgs << "," << m_daoBytesSaved << "\n";
+    }
+    if (m_srPkts > 0) {
+      std::ofstream f("results/" + prefix + "_source_routes.csv");
+      double n = static_cast<double>(m_srPkts);
+      f << "packets,avg_hops,avg_srh_bytes,srh_bytes,avg_lookups,avg_lookup_ns\n";
+      f << m_srPkts << "," << m_srHops / n << "," << m_srBytes / n << "," << m_srBytes << ","
+        << m_srLookups / n << "," << m_srLookupNs / n << "\n";
+    }
+    if (m_conDone + m_conFailed > 0) {
+      std::ofstream f("results/" + prefix + "_confirmable.csv");
+      double span = (m_conLastAck - m_conFirstTx).GetSeconds();
+      double goodput = (span > 0.0) ? static_cast<double>(m_conBytes) * 8.0 / span : 0.0;
+      double avgLat = (m_conDone > 0) ? m_conLatencySum.GetSeconds() / static_cast<double>(m_conDone) : 0.0;
+      double retxRatio = (m_totalTx > 0) ? static_cast<double>(m_retx) / static_cast<double>(m_totalTx) : 0.0;
+      f << "completed,failed,goodput_bps,avg_completion_s,p95_completion_s,retransmissions,retx_bytes,retx_per_msg\n";
+      f << m_conDone << "," << m_conFailed << "," << goodput << "," << avgLat << ","
+        << m_conLatency.Quantile(0.95) << "," << m_retx << "," << m_retxBytes << "," << retxRatio << "\n";
+    }
   }
 
 private:
+  // Keeps the per-interval counts rather than judging outage here: packets
+  // sent in one partition are received in another, so outage is decided
+  // after the shards are merged.
+  void CheckDelivery() {
+    uint64_t dtx = m_totalTx - m_outageLastTx, drx = m_totalRx - m_outageLastRx;
+    m_outageLastTx = m_totalTx; m_outageLastRx = m_totalRx;
+    if (m_outageOn) { m_outageTx.push_back(dtx); m_outageRx.push_back(drx); }
+    for (auto &cb : m_deliveryWatchers) cb(dtx, drx);
+    Simulator::Schedule(m_outageInterval, &MetricsCollector::CheckDelivery, this);
+  }
+
+  // Every field that ends up in a CSV, in one order for both archives.
+  template <typename A> void Visit(A &ar) {
+    ar.Io(m_totalTx); ar.Io(m_totalRx); ar.Io(m_sumDelay);
+    ar.Io(m_controlTx); ar.Io(m_controlRx); ar.Io(m_controlDropped); ar.Io(m_controlSuppressed);
+    ar.Io(m_tp); ar.Io(m_fp); ar.Io(m_tn); ar.Io(m_fn); ar.Io(m_threshold); ar.Io(m_windowSec);
+    ar.Io(m_jitter);
+    ar.Io(m_conDone); ar.Io(m_conFailed); ar.Io(m_conBytes); ar.Io(m_conFirstTx); ar.Io(m_conLastAck);
+    ar.Io(m_conLatencySum); ar.Io(m_conLatency); ar.Io(m_retx); ar.Io(m_retxBytes);
+    ar.Io(m_routing); ar.Io(m_roots); ar.Io(m_rootOf); ar.Io(m_border); ar.Io(m_routeMode);
+    ar.Io(m_disRx); ar.Io(m_disLimited); ar.Io(m_disResets); ar.Io(m_rootRepairs); ar.Io(m_nodeRepairs);
+    ar.Io(m_outageInterval); ar.Io(m_outageFloor); ar.Io(m_outageTx); ar.Io(m_outageRx);
+    ar.Io(m_daoMsgs); ar.Io(m_daoTargets); ar.Io(m_daoBytesSaved); ar.Io(m_tables);
+    ar.Io(m_srPkts); ar.Io(m_srHops); ar.Io(m_srBytes); ar.Io(m_srLookups); ar.Io(m_srLookupNs);
+    ar.Io(m_rplTx); ar.Io(m_rplTxBytes);
+    ar.Io(m_peakDetectorState); ar.Io(m_detectorPurged);
+    ar.Io(m_saviChecked); ar.Io(m_saviSpoofed); ar.Io(m_saviDropped);
+    ar.Io(m_allowFast); ar.Io(m_allowSampled); ar.Io(m_allowRevoked);
+  }
+
+  struct JitterStats {
+    Time jitter{Seconds(0)};
+    Time maxJitter{Seconds(0)};
+    LogHistogram ipdv;
+    template <typename A> void Io(A &ar) { ar.Io(jitter); ar.Io(maxJitter); ar.Io(ipdv); }
+  };
+  std::map<std::pair<uint32_t, Ipv6Address>, JitterStats> m_jitter;
+
+  uint64_t m_conDone{0};
+  uint64_t m_conFailed{0};
+  uint64_t m_conBytes{0};
+  Time     m_conFirstTx{Seconds(0)};
+  Time     m_conLastAck{Seconds(0)};
+  Time     m_conLatencySum{Seconds(0)};
+  LogHistogram m_conLatency;
+  uint64_t m_retx{0};
+  uint64_t m_retxBytes{0};
+  struct RouteInfo {
+    int32_t parent; uint16_t rank; uint32_t switches; uint32_t neighbours; Ipv6Address dodag;
+    template <typename A> void Io(A &ar) { ar.Io(parent); ar.Io(rank); ar.Io(switches); ar.Io(neighbours); ar.Io(dodag); }
+  };
+  std::map<uint32_t, RouteInfo> m_routing;
+  struct RootLoad { uint64_t rx{0}; uint64_t peakPps{0}; uint32_t saturatedSec{0}; uint32_t failovers{0}; };
+  std::map<uint32_t, RootLoad> m_roots;
+  std::map<Ipv6Address, uint32_t> m_rootOf;
+  struct BorderStats { uint64_t up{0}; uint64_t down{0}; uint64_t dropped{0}; };
+  std::map<uint32_t, BorderStats> m_border;
+  std::string m_routeMode;
+  uint64_t m_disRx{0};
+  uint64_t m_disLimited{0};
+  uint64_t m_disResets{0};
+  uint64_t m_rootRepairs{0};
+  uint64_t m_nodeRepairs{0};
+  Time     m_outageInterval{Seconds(1)};
+  double   m_outageFloor{0.5};
+  uint64_t m_outageLastTx{0};
+  uint64_t m_outageLastRx{0};
+  bool     m_sampling{false};
+  bool     m_outageOn{false};
+  std::vector<Callback<void, uint64_t, uint64_t>> m_deliveryWatchers;
+  std::vector<uint64_t> m_outageTx;
+  std::vector<uint64_t> m_outageRx;
+  uint64_t m_daoMsgs{0};
+  uint64_t m_daoTargets{0};
+  uint64_t m_daoBytesSaved{0};
+  struct RouteTable { uint64_t entries{0}; uint64_t peakEntries{0}; uint64_t peakBytes{0}; };
+  std::map<uint32_t, RouteTable> m_tables;
+  uint64_t m_srPkts{0};
+  uint64_t m_srHops{0};
+  uint64_t m_srBytes{0};
+  uint64_t m_srLookups{0};
+  double   m_srLookupNs{0.0};
+  std::array<uint64_t, 4> m_rplTx{};
+  uint64_t m_rplTxBytes{0};
+  uint64_t m_peakDetectorState{0};
+  uint64_t m_detectorPurged{0};
+  uint64_t m_saviChecked{0};
+  uint64_t m_saviSpoofed{0};
+  uint64_t m_saviDropped{0};
+  uint64_t m_allowFast{0};
+  uint64_t m_allowSampled{0};
+  uint64_t m_allowRevoked{0};
+
   uint64_t m_totalTx{0};
   uint64_t m_totalRx{0};
   Time     m_sumDelay{Seconds(0)};
   uint64_t m_controlTx{0};
   uint64_t m_controlRx{0};
   uint64_t m_controlDropped{0};
+  uint64_t m_controlSuppressed{0};
+  uint64_t m_tp{0}, m_fp{0}, m_tn{0}, m_fn{0};
+  uint32_t m_threshold{0};
+  double m_windowSec{0.0};
+};
+
+// ---------------- TriggeredCapture ----------------
+// Keeps a small rolling buffer of sniffed frames per node and only writes
+// pcap around trigger events (block decisions, PDR drops). Frames older than
+// the pre-window or beyond the per-node byte budget are discarded in memory.
+class TriggeredCapture {
+public:
+  TriggeredCapture() = default;
+  void Setup(Time preWindow, Time postWindow, uint32_t nodeBufBytes, uint64_t maxTotalBytes, const std::string &prefix) {
+    m_pre = preWindow; m_post = postWindow;
+    m_nodeBufBytes = nodeBufBytes; m_maxTotalBytes = maxTotalBytes;
+    m_prefix = prefix;
+  }
+
+  void Attach(Ptr<LrWpanNetDevice> dev, uint32_t nodeId) {
+    if (m_rings.size() <= nodeId) m_rings.resize(nodeId + 1);
+    Ptr<LrWpanMac> mac = dev->GetMac();
+    // PromiscSniffer fires for every frame sent and every frame decoded
+    mac->TraceConnectWithoutContext("PromiscSniffer", MakeBoundCallback(&TriggeredCapture::OnFrame, this, nodeId));
+  }
+
+  // Flush every node's pre-window and keep writing until now + post-window.
+  void Trigger(const std::string &reason) {
+    Time now = Simulator::Now();
+    uint64_t before = m_writtenBytes;
+    uint32_t frames = 0;
+    for (uint32_t n = 0; n < m_rings.size(); ++n) {
+      Ring &r = m_rings[n];
+      for (const Frame &fr : r.frames) {
+        if (now - fr.t <= m_pre && Write(n, fr.t, fr.p)) frames++;
+      }
+      r.frames.clear();
+      r.bytes = 0;
+    }
+    m_postUntil = std::max(m_postUntil, now + m_post);
+    m_events.push_back({now, reason, frames, m_writtenBytes - before});
+  }
+
+  // Compares each interval PDR from the collector's sampler against a floor
+  // and triggers on the falling edge only, so a sustained outage produces
+  // one capture.
+  void WatchPdr(MetricsCollector *m, Time interval, double floor) {
+    m_pdrFloor = floor;
+    m->OnDeliveryInterval(MakeCallback(&TriggeredCapture::CheckPdr, this));
+    m->SampleDelivery(interval);
+  }
+
+  void WriteCsv() {
+    std::filesystem::create_directories("results");
+    std::ofstream f("results/" + m_prefix + "_capture.csv");
+    f << "time_s,reason,frames,bytes\n";
+    for (const Event &e : m_events) {
+      f << e.t.GetSeconds() << "," << e.reason << "," << e.frames << "," << e.bytes << "\n";
+    }
+    f << "total,,," << m_writtenBytes << "\n";
+    f << "suppressed,,," << m_suppressedBytes << "\n";
+  }
+
+private:
+  struct Frame { Time t; Ptr<const Packet> p; };
+  struct Ring {
+    std::deque<Frame> frames;
+    uint32_t bytes{0};
+    Ptr<PcapFileWrapper> file;
+  };
+  struct Event { Time t; std::string reason; uint32_t frames; uint64_t bytes; };
+
+  static void OnFrame(TriggeredCapture *self, uint32_t nodeId, Ptr<const Packet> p) {
+    self->Buffer(nodeId, p);
+  }
+
+  void Buffer(uint32_t nodeId, Ptr<const Packet> p) {
+    Time now = Simulator::Now();
+    if (now <= m_postUntil) { Write(nodeId, now, p); return; }
+    Ring &r = m_rings[nodeId];
+    r.frames.push_back({now, p});
+    r.bytes += p->GetSize();
+    while (!r.frames.empty() &&
+           (r.bytes > m_nodeBufBytes || now - r.frames.front().t > m_pre)) {
+      r.bytes -= r.frames.front().p->GetSize();
+      r.frames.pop_front();
+    }
+  }
+
+  bool Write(uint32_t nodeId, Time t, Ptr<const Packet> p) {
+    if (m_writtenBytes + p->GetSize() > m_maxTotalBytes) {
+      m_suppressedBytes += p->GetSize();
+      return false;
+    }
+    Ring &r = m_rings[nodeId];
+    if (!r.file) {
+      std::filesystem::create_directories("results");
+      PcapHelper ph;
+      r.file = ph.CreateFile("results/" + m_prefix + "_cap_node" + std::to_string(nodeId) + ".pcap",
+                             std::ios::out, PcapHelper::DLT_IEEE802_15_4);
+    }
+    r.file->Write(t, p);
+    m_writtenBytes += p->GetSize();
+    return true;
+  }
+
+  void CheckPdr(uint64_t dtx, uint64_t drx) {
+    if (dtx == 0) return;
+    bool low = static_cast<double>(drx) / static_cast<double>(dtx) < m_pdrFloor;
+    if (low && !m_pdrLow) Trigger("pdr_drop");
+    m_pdrLow = low;
+  }
+
+  std::vector<Ring> m_rings;
+  std::vector<Event> m_events;
+  std::string m_prefix{"run1"};
+  Time m_pre{MilliSeconds(500)};
+  Time m_post{MilliSeconds(500)};
+  Time m_postUntil{Seconds(-1)};
+  uint32_t m_nodeBufBytes{16384};
+  uint64_t m_maxTotalBytes{4 << 20};
+  uint64_t m_writtenBytes{0};
+  uint64_t m_suppressedBytes{0};
+
+  double m_pdrFloor{0.8};
+  bool m_pdrLow{false};
+};
+
+static TriggeredCapture *g_capture = nullptr;
+
+// ---------------- ChurnController ----------------
+// Takes nodes down and back up at scheduled times. A reboot may come back
+// with a fresh global address (attacker shedding its blocked identity).
+// Recovery is the time from coming back up to the first delivered downward
+// packet at that node, or to the Mitigator blocking the new address.
+class ChurnController {
+public:
+  struct Spec { uint32_t node; double down; double up; bool readdr; };
+
+  // "node:down:up[:readdr],..." e.g. "5:30:40,24:50:52:readdr"
+  static std::vector<Spec> Parse(const std::string &text) {
+    std::vector<Spec> out;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      if (item.empty()) continue;
+      std::stringstream is(item);
+      std::string tok;
+      std::vector<std::string> f;
+      while (std::getline(is, tok, ':')) f.push_back(tok);
+      NS_ABORT_MSG_IF(f.size() < 3, "Bad churn entry: " << item);
+      out.push_back({static_cast<uint32_t>(std::stoul(f[0])), std::stod(f[1]), std::stod(f[2]),
+                     f.size() > 3 && f[3] == "readdr"});
+    }
+    return out;
+  }
+
+  void Setup(const NodeContainer &nodes) { m_nodes = nodes; }
+
+  void Schedule(const std::vector<Spec> &specs) {
+    for (const Spec &sp : specs) {
+      NS_ABORT_MSG_IF(sp.node >= m_nodes.GetN() || sp.up <= sp.down, "Bad churn entry for node " << sp.node);
+      size_t idx = m_events.size();
+      m_events.push_back({sp, Ipv6Address(), Ipv6Address(), Seconds(0), false, false});
+      Simulator::Schedule(Seconds(sp.down), &ChurnController::Down, this, idx);
+      Simulator::Schedule(Seconds(sp.up), &ChurnController::Up, this, idx);
+    }
+  }
+
+  void OnDelivered(uint32_t nodeId) {
+    for (Event &e : m_events) {
+      if (e.up && !e.recovered && !e.spec.readdr && e.spec.node == nodeId) {
+        e.recovery = Simulator::Now() - Seconds(e.spec.up);
+        e.recovered = true;
+      }
+    }
+  }
+  void OnBlock(const Ipv6Address &src) {
+    for (Event &e : m_events) {
+      if (e.up && !e.recovered && e.spec.readdr && e.newAddr == src) {
+        e.recovery = Simulator::Now() - Seconds(e.spec.up);
+        e.recovered = true;
+      }
+    }
+  }
+
+  void WriteCsv(const std::string &prefix) {
+    std::filesystem::create_directories("results");
+    std::ofstream f("results/" + prefix + "_churn.csv");
+    f << "node,down_s,up_s,readdr,old_addr,new_addr,recovery_s\n";
+    for (const Event &e : m_events) {
+      f << e.spec.node << "," << e.spec.down << "," << e.spec.up << "," << e.spec.readdr << ","
+        << e.oldAddr << "," << e.newAddr << ",";
+      if (e.recovered) f << e.recovery.GetSeconds();
+      f << "\n";
+    }
+  }
+
+private:
+  struct Event {
+    Spec spec;
+    Ipv6Address oldAddr;
+    Ipv6Address newAddr;
+    Time recovery;
+    bool recovered;
+    bool up;
+  };
+
+  // Global (non link-local) address index on the node's 6LoWPAN interface.
+  static uint32_t GlobalIndex(Ptr<Ipv6> ip, uint32_t ifIndex) {
+    for (uint32_t a = 0; a < ip->GetNAddresses(ifIndex); ++a) {
+      if (!ip->GetAddress(ifIndex, a).GetAddress().IsLinkLocal()) return a;
+    }
+    return 0;
+  }
+
+  void Down(size_t idx) {
+    Event &e = m_events[idx];
+    Ptr<Ipv6> ip = m_nodes.Get(e.spec.node)->GetObject<Ipv6>();
+    e.oldAddr = ip->GetAddress(1, GlobalIndex(ip, 1)).GetAddress();
+    e.newAddr = e.oldAddr;
+    ip->SetDown(1);
+  }
+
+  void Up(size_t idx) {
+    Event &e = m_events[idx];
+    Ptr<Ipv6> ip = m_nodes.Get(e.spec.node)->GetObject<Ipv6>();
+    if (e.spec.readdr) {
+      ip->RemoveAddress(1, GlobalIndex(ip, 1));
+      Mac64Address fresh(0x02000000c0000000ULL + (++m_freshCounter));
+      e.newAddr = Ipv6Address::MakeAutoconfiguredAddress(fresh, e.oldAddr.CombinePrefix(Ipv6Prefix(64)));
+      ip->AddAddress(1, Ipv6InterfaceAddress(e.newAddr, Ipv6Prefix(64)));
+    }
+    ip->SetUp(1);
+    e.up = true;
+  }
+
+  NodeContainer m_nodes;
+  std::vector<Event> m_events;
+  uint64_t m_freshCounter{0};
+};
+
+static ChurnController *g_churn = nullptr;
+
+// ---------------- MobilityTracker ----------------
+// Samples positions periodically and derives each node's parent as the
+// in-range neighbour closest to a root (the nearest root itself when in
+// range); roots are nodes 0..nRoots-1.
+// Counts parent changes and logs where the attacker is whenever its
+// parent changes or the Mitigator blocks it.
+class MobilityTracker {
+public:
+  void Setup(const NodeContainer &nodes, uint32_t nRoots, int32_t attackerId, double range, Time interval) {
+    m_nodes = nodes; m_roots = nRoots; m_attacker = attackerId; m_range = range; m_interval = interval;
+    m_parent.assign(nodes.GetN(), -1);
+    m_changes.assign(nodes.GetN(), 0);
+    m_travelled.assign(nodes.GetN(), 0.0);
+    for (uint32_t i = 0; i < nodes.GetN(); ++i) m_last.push_back(Position(i));
+    Simulator::Schedule(Seconds(0), &MobilityTracker::Sample, this);
+  }
+  void SetKind(uint32_t node, const std::string &kind) { m_kind[node] = kind; }
+  // Parents come from the routing agent instead of geometry.
+  void UseExternalParents() { m_external = true; }
+  void OnParentChange(uint32_t node, int32_t parent) { SetParent(node, parent); }
+
+  void OnBlock(const Ipv6Address &src) {
+    if (m_attacker < 0) return;
+    Ptr<Ipv6> ip = m_nodes.Get(m_attacker)->GetObject<Ipv6>();
+    if (ip->GetAddress(1, 1).GetAddress() == src) Log("block");
+  }
+
+  void WriteCsv(const std::string &prefix) {
+    std::filesystem::create_directories("results");
+    {
+      std::ofstream f("results/" + prefix + "_mobility.csv");
+      f << "node,kind,parent_changes,distance_m\n";
+      for (uint32_t i = 0; i < m_nodes.GetN(); ++i) {
+        auto it = m_kind.find(i);
+        f << i << "," << (it != m_kind.end() ? it->second : "static") << ","
+          << m_changes[i] << "," << m_travelled[i] << "\n";
+      }
+    }
+    if (m_attacker >= 0) {
+      std::ofstream f("results/" + prefix + "_attacker_track.csv");
+      f << "time_s,event,x,y,parent\n";
+      for (const Track &t : m_track) {
+        f << t.t.GetSeconds() << "," << t.event << "," << t.pos.x << "," << t.pos.y << "," << t.parent << "\n";
+      }
+    }
+  }
+
+private:
+  struct Track { Time t; std::string event; Vector pos; int32_t parent; };
+
+  Vector Position(uint32_t i) const { return m_nodes.Get(i)->GetObject<MobilityModel>()->GetPosition(); }
+
+  // Nearest root to a position and its distance.
+  std::pair<uint32_t, double> NearestRoot(const Vector &p) const {
+    std::pair<uint32_t, double> best{0, CalculateDistance(p, Position(0))};
+    for (uint32_t r = 1; r < m_roots; ++r) {
+      double d = CalculateDistance(p, Position(r));
+      if (d < best.second) best = {r, d};
+    }
+    return best;
+  }
+
+  int32_t PickParent(uint32_t i) const {
+    Vector me = Position(i);
+    auto root = NearestRoot(me);
+    if (root.second <= m_range) return root.first;
+    int32_t best = -1;
+    double bestToRoot = root.second;
+    for (uint32_t j = m_roots; j < m_nodes.GetN(); ++j) {
+      if (j == i || static_cast<int32_t>(j) == m_attacker) continue;
+      Vector pj = Position(j);
+      double toRoot = NearestRoot(pj).second;
+      if (CalculateDistance(me, pj) <= m_range && toRoot < bestToRoot) { best = j; bestToRoot = toRoot; }
+    }
+    return best;
+  }
+
+  void Sample() {
+    for (uint32_t i = 0; i < m_nodes.GetN(); ++i) {
+      Vector p = Position(i);
+      m_travelled[i] += CalculateDistance(p, m_last[i]);
+      m_last[i] = p;
+      if (i < m_roots || m_external) continue;
+      SetParent(i, PickParent(i));
+    }
+    Simulator::Schedule(m_interval, &MobilityTracker::Sample, this);
+  }
+
+  void SetParent(uint32_t i, int32_t parent) {
+    if (parent == m_parent[i]) return;
+    if (m_parent[i] != -1 || Simulator::Now().IsStrictlyPositive()) m_changes[i]++;
+    m_parent[i] = parent;
+    if (static_cast<int32_t>(i) == m_attacker) Log("parent_change");
+  }
+
+  void Log(const std::string &event) {
+    m_track.push_back({Simulator::Now(), event, Position(m_attacker), m_parent[m_attacker]});
+  }
+
+  NodeContainer m_nodes;
+  uint32_t m_roots{1};
+  int32_t m_attacker{-1};
+  double m_range{30.0};
+  Time m_interval{Seconds(1)};
+  std::vector<int32_t> m_parent;
+  std::vector<uint32_t> m_changes;
+  std::vector<double> m_travelled;
+  std::vector<Vector> m_last;
+  std::map<uint32_t, std::string> m_kind;
+  std::vector<Track> m_track;
+  bool m_external{false};
 };
 
+static MobilityTracker *g_mobility = nullptr;
+
+// ---------------- LinkSecurityModel ----------------
+// Cost model for 802.15.4 frame security (AES-CCM*, security levels 5-7).
+// Every frame grows by the auxiliary security header (security control,
+// 4-byte frame counter, key index) plus the MIC; the bytes ride in the UDP
+// payload so they cost real airtime on every hop. CCM processing is not
+// simulated on the radio path: each link adds one encrypt and one decrypt
+// of cpuUs to a delivered packet's latency analytically. Frames are never
+// rejected, so this prices the crypto alternative rather than defending.
+class LinkSecurityModel {
+public:
+  static constexpr uint32_t kAuxHeaderBytes = 6;
+  static constexpr double kRadioBps = 250000.0;
+  static constexpr double kTxMw = 52.2;  // CC2420-class, 0 dBm
+  static constexpr double kRxMw = 59.1;
+
+  void Setup(const std::string &mode, Time cpuPerFrame, double cpuMw) {
+    uint32_t mic = (mode == "mic32") ? 4 : (mode == "mic64") ? 8 : 16;
+    m_mode = mode; m_overhead = kAuxHeaderBytes + mic; m_cpu = cpuPerFrame; m_cpuMw = cpuMw;
+  }
+  uint32_t Overhead() const { return m_overhead; }
+  // Links on every delivered path that are not 802.15.4 (the backhaul hop
+  // from a server) and so carry no link-layer security.
+  void SetWiredHops(uint32_t hops) { m_wiredHops = hops; }
+
+  void Pad(Ptr<Packet> p) {
+    p->AddAtEnd(Create<Packet>(m_overhead));
+    m_frames++;
+  }
+
+  // Returns the processing delay of a packet that crossed the given number
+  // of links (encrypt at each sender, decrypt at each receiver).
+  Time Deliver(uint32_t hops, Time baseDelay) {
+    hops = (hops > m_wiredHops) ? hops - m_wiredHops : 1;
+    Time added = m_cpu * (2 * hops);
+    m_delivered++;
+    m_hops += hops;
+    m_baseDelay += baseDelay;
+    m_addedDelay += added;
+    return added;
+  }
+
+  void WriteCsv(const std::string &prefix, Time duration) {
+    std::filesystem::create_directories("results");
+    std::ofstream f("results/" + prefix + "_llsec.csv");
+    double meanHops = m_delivered ? static_cast<double>(m_hops) / m_delivered : 1.0;
+    // Control frames are not traced per hop; charge them the data path length.
+    double linkFrames = m_frames * meanHops;
+    double airtime = linkFrames * m_overhead * 8.0 / kRadioBps;
+    double cpuTime = linkFrames * 2 * m_cpu.GetSeconds();
+    f << "mode,overhead_bytes,frames,delivered,mean_hops,latency_plain_ms,latency_secured_ms,"
+         "extra_airtime_s,airtime_share,cpu_energy_mj,radio_energy_mj\n";
+    f << m_mode << "," << m_overhead << "," << m_frames << "," << m_delivered << "," << meanHops << ","
+      << (m_delivered ? m_baseDelay.GetMilliSeconds() / static_cast<double>(m_delivered) : 0.0) << ","
+      << (m_delivered ? (m_baseDelay + m_addedDelay).GetMilliSeconds() / static_cast<double>(m_delivered) : 0.0) << ","
+      << airtime << "," << (duration.IsStrictlyPositive() ? airtime / duration.GetSeconds() : 0.0) << ","
+      << cpuTime * m_cpuMw << "," << airtime * (kTxMw + kRxMw) << "\n";
+  }
+
+private:
+  std::string m_mode{"mic64"};
+  uint32_t m_overhead{kAuxHeaderBytes + 8};
+  Time m_cpu{MicroSeconds(200)};
+  double m_cpuMw{3.0};
+  uint32_t m_wiredHops{0};
+  uint64_t m_frames{0};
+  uint64_t m_delivered{0};
+  uint64_t m_hops{0};
+  Time m_baseDelay{Seconds(0)};
+  Time m_addedDelay{Seconds(0)};
+};
+
+static LinkSecurityModel *g_llsec = nullptr;
+
+// Cycles through pts at constant speed until the given time.
+static void AddLoopPath(Ptr<WaypointMobilityModel> wp, const std::vector<Vector> &pts, double speed, double until) {
+  double t = 0.0;
+  size_t k = 0;
+  wp->AddWaypoint(Waypoint(Seconds(t), pts[0]));
+  while (t < until && pts.size() > 1) {
+    const Vector &a = pts[k % pts.size()], &b = pts[(k + 1) % pts.size()];
+    t += std::max(0.1, CalculateDistance(a, b) / speed);
+    wp->AddWaypoint(Waypoint(Seconds(t), b));
+    k++;
+  }
+}
+
 // ---------------- DownSender (root) ----------------
 class DownSender : public Application {
 public:
@@ -89,29 +1046,94 @@ public:
     double totalPps = (rateKbps * 1000.0) / bitsPerPkt;
     m_gap = Seconds( (totalPps > 0.0) ? (1.0 / totalPps) : 0.05 );
   }
+  // CoAP-style reliability (RFC 7252 4.2): initial timeout drawn from
+  // [ackTimeout, 1.5 * ackTimeout], doubled on every retransmission.
+  void SetConfirmable(Time ackTimeout, uint32_t maxRetransmit) {
+    m_confirmable = true;
+    m_ackTimeout = ackTimeout;
+    m_maxRetransmit = maxRetransmit;
+  }
 
 private:
   void StartApplication() override {
     m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    if (m_confirmable) m_socket->SetRecvCallback(MakeCallback(&DownSender::HandleAck, this));
     m_event = Simulator::Schedule(Seconds(1.0), &DownSender::Tick, this);
   }
   void StopApplication() override {
     if (m_event.IsPending()) Simulator::Cancel(m_event);
+    for (auto &kv : m_pending) Simulator::Cancel(kv.second.timer);
+    m_pending.clear();
     if (m_socket) m_socket->Close();
   }
   void Tick() {
     if (m_dests.empty()) { m_event = EventId(); return; }
     Inet6SocketAddress to = m_dests[m_rr % m_dests.size()];
     PayloadHdr ph; ph.seq = m_seq++; ph.txTime = Simulator::Now().GetSeconds();
+    ph.type = m_confirmable ? kMsgCon : kMsgNon;
     Ptr<Packet> p = Create<Packet>(reinterpret_cast<uint8_t*>(&ph), sizeof(ph));
     uint32_t pad = (m_pktSize > sizeof(ph)) ? (m_pktSize - sizeof(ph)) : 0;
     if (pad) { Ptr<Packet> padp = Create<Packet>(pad); p->AddAtEnd(padp); }
-    m_socket->SendTo(p, 0, Address(to));
+    if (g_llsec) g_llsec->Pad(p);
+    m_socket->SendTo(p->Copy(), 0, Address(to));
     if (m_metrics) m_metrics->NoteTxPacket(p);
+    if (m_confirmable) {
+      Pending &pd = m_pending[ph.seq];
+      pd.to = to; pd.pkt = p; pd.firstTx = Simulator::Now();
+      pd.timeout = m_ackTimeout * m_rand->GetValue(1.0, 1.5);
+      pd.timer = Simulator::Schedule(pd.timeout, &DownSender::Retransmit, this, ph.seq);
+    }
     m_rr++;
     m_event = Simulator::Schedule(m_gap, &DownSender::Tick, this);
   }
 
+  void Retransmit(uint32_t seq) {
+    auto it = m_pending.find(seq);
+    if (it == m_pending.end()) return;
+    Pending &pd = it->second;
+    if (pd.retries >= m_maxRetransmit) {
+      if (m_metrics) m_metrics->NoteConfirmableFailed();
+      m_pending.erase(it);
+      return;
+    }
+    pd.retries++;
+    pd.timeout = pd.timeout * 2;
+    m_socket->SendTo(pd.pkt->Copy(), 0, Address(pd.to));
+    if (m_metrics) m_metrics->NoteRetransmission(pd.pkt->GetSize());
+    pd.timer = Simulator::Schedule(pd.timeout, &DownSender::Retransmit, this, seq);
+  }
+
+  void HandleAck(Ptr<Socket> s) {
+    Address from;
+    Ptr<Packet> p;
+    while ((p = s->RecvFrom(from))) {
+      if (p->GetSize() < sizeof(PayloadHdr)) continue;
+      PayloadHdr ph;
+      p->CopyData(reinterpret_cast<uint8_t*>(&ph), sizeof(ph));
+      if (ph.type != kMsgAck) continue;
+      auto it = m_pending.find(ph.seq);
+      if (it == m_pending.end()) continue;  // duplicate ACK or already given up
+      Simulator::Cancel(it->second.timer);
+      Time now = Simulator::Now();
+      if (m_metrics) m_metrics->NoteConfirmableDone(it->second.firstTx, now - it->second.firstTx, m_pktSize);
+      m_pending.erase(it);
+    }
+  }
+
+  struct Pending {
+    Inet6SocketAddress to{Ipv6Address::GetAny(), 0};
+    Ptr<Packet> pkt;
+    Time firstTx;
+    Time timeout;
+    uint32_t retries{0};
+    EventId timer;
+  };
+  std::map<uint32_t, Pending> m_pending;
+  bool m_confirmable{false};
+  Time m_ackTimeout{Seconds(2)};
+  uint32_t m_maxRetransmit{4};
+  Ptr<UniformRandomVariable> m_rand{CreateObject<UniformRandomVariable>()};
+
   Ptr<Socket> m_socket;
   EventId m_event;
   std::vector<Inet6SocketAddress> m_dests;
@@ -133,6 +1155,7 @@ private:
     m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
     m_socket->Bind(Inet6SocketAddress(Ipv6Address::GetAny(), m_port));
     m_socket->SetRecvCallback(MakeCallback(&DownSink::HandleRecv, this));
+    if (g_llsec) m_socket->SetIpv6RecvHopLimit(true);
   }
   void StopApplication() override { if (m_socket) m_socket->Close(); }
   void HandleRecv(Ptr<Socket> s) {
@@ -143,17 +1166,167 @@ private:
       PayloadHdr ph;
       p->CopyData(reinterpret_cast<uint8_t*>(&ph), sizeof(ph));
       Time delay = Seconds(Simulator::Now().GetSeconds() - ph.txTime);
+      if (ph.type == kMsgCon) {
+        PayloadHdr ack = ph; ack.type = kMsgAck;
+        Ptr<Packet> ap = Create<Packet>(reinterpret_cast<uint8_t*>(&ack), sizeof(ack));
+        if (g_llsec) g_llsec->Pad(ap);
+        s->SendTo(ap, 0, from);
+        if (IsDuplicate(from, ph.seq)) return;
+      }
+      if (g_llsec) {
+        // Hosts send with hop limit 64, so 65 - received is the link count
+        // (the model drops the wired backhaul hop, if any).
+        SocketIpv6HopLimitTag hl;
+        uint32_t hops = p->PeekPacketTag(hl) ? 65u - std::min<uint32_t>(hl.GetHopLimit(), 64) : 1u;
+        delay += g_llsec->Deliver(hops, delay);
+      }
       if (m_metrics) m_metrics->NoteRxPacket(p, delay);
+      if (g_churn) g_churn->OnDelivered(GetNode()->GetId());
+      if (Inet6SocketAddress::IsMatchingType(from)) {
+        UpdateJitter(Inet6SocketAddress::ConvertFrom(from).GetIpv6(), delay);
+      }
     } else {
       if (m_metrics) m_metrics->NoteRxPacket(p, MilliSeconds(1));
     }
   }
 
+  // Confirmable retransmissions are ACKed again but counted once.
+  bool IsDuplicate(const Address &from, uint32_t seq) {
+    std::set<uint32_t> &seen = m_seen[from];
+    if (!seen.insert(seq).second) return true;
+    if (seen.size() > 256) seen.erase(seen.begin());
+    return false;
+  }
+
+  // RFC 3550 6.4.1: J += (|D(i-1,i)| - J) / 16, with D the transit-time
+  // difference of consecutive packets of the same flow.
+  void UpdateJitter(const Ipv6Address &src, Time transit) {
+    FlowJitter &fj = m_flows[src];
+    if (fj.seen) {
+      Time d = Abs(transit - fj.lastTransit);
+      fj.jitter += NanoSeconds((d - fj.jitter).GetNanoSeconds() / 16);
+      if (m_metrics) m_metrics->NoteJitter(GetNode()->GetId(), src, fj.jitter, d);
+    }
+    fj.lastTransit = transit;
+    fj.seen = true;
+  }
+
+  struct FlowJitter {
+    Time lastTransit{Seconds(0)};
+    Time jitter{Seconds(0)};
+    bool seen{false};
+  };
+  std::map<Ipv6Address, FlowJitter> m_flows;
+  std::map<Address, std::set<uint32_t>> m_seen;
+
   Ptr<Socket> m_socket;
   uint16_t m_port{0};
   MetricsCollector *m_metrics{nullptr};
 };
 
+// ns-3 autoconfigures link-local and global addresses from the same device
+// address, so the link-local next hop of a global address shares its IID.
+static Ipv6Address LinkLocalOf(const Ipv6Address &global) {
+  uint8_t b[16];
+  global.GetBytes(b);
+  b[0] = 0xfe; b[1] = 0x80;
+  for (uint32_t k = 2; k < 8; ++k) b[k] = 0;
+  return Ipv6Address(b);
+}
+
+// ---------------- Source address validation ----------------
+// SAVI-style check at a root: each link-layer sender (short or extended
+// address) is bound to the IPv6 address it owns. A packet whose source is
+// neither the sender's own address nor, when relayed, one the root routes
+// through that sender is tagged with the sender's bound address; the
+// Mitigator drops it and charges the real sender instead.
+class SaviTag : public Tag {
+public:
+  static TypeId GetTypeId() {
+    static TypeId tid = TypeId("SaviTag")
+      .SetParent<Tag>()
+      .AddConstructor<SaviTag>();
+    return tid;
+  }
+  TypeId GetInstanceTypeId() const override { return GetTypeId(); }
+  uint32_t GetSerializedSize() const override { return 16; }
+  void Serialize(TagBuffer i) const override { uint8_t b[16]; sender.Serialize(b); i.Write(b, 16); }
+  void Deserialize(TagBuffer i) override { uint8_t b[16]; i.Read(b, 16); sender = Ipv6Address::Deserialize(b); }
+  void Print(std::ostream &os) const override { os << "sender=" << sender; }
+
+  Ipv6Address sender;
+};
+
+class SourceValidator {
+public:
+  SourceValidator() = default;
+  void Setup(MetricsCollector *m) { m_metrics = m; }
+  // Register on the root's 6LoWPAN device before the IPv6 interface is
+  // added, so this handler sees (and tags) each packet before IPv6 copies it.
+  void Attach(Ptr<Node> node, Ptr<NetDevice> sixDev) {
+    node->RegisterProtocolHandler(MakeCallback(&SourceValidator::Receive, this), 0x86DD, sixDev);
+  }
+  void Bind(const Address &l2, const Ipv6Address &owner) { m_bound[Key(l2)] = owner; }
+  // Relayed packets (hop limit below the default) are accepted only if this
+  // returns true for (source, sender address); without it, none are.
+  void SetRelayCheck(Callback<bool, Ipv6Address, Ipv6Address> cb) { m_relayCheck = cb; }
+
+private:
+  static uint64_t Key(const Address &a) {
+    uint8_t b[8] = {0};
+    if (Mac16Address::IsMatchingType(a)) { Mac16Address::ConvertFrom(a).CopyTo(b); return (1ull << 63) | (b[0] << 8) | b[1]; }
+    if (Mac64Address::IsMatchingType(a)) {
+      Mac64Address::ConvertFrom(a).CopyTo(b);
+      uint64_t v = 0;
+      for (uint32_t k = 0; k < 8; ++k) v = (v << 8) | b[k];
+      return v;
+    }
+    return 0;
+  }
+
+  void Receive(Ptr<NetDevice>, Ptr<const Packet> p, uint16_t, const Address &from, const Address &, NetDevice::PacketType) {
+    Ipv6Header ip;
+    if (p->PeekHeader(ip) == 0) return;
+    auto it = m_bound.find(Key(from));
+    if (it == m_bound.end()) return;   // unknown sender: nothing to bind against
+    const Ipv6Address &src = ip.GetSource(), &owner = it->second;
+    bool ok = (src == owner || src == LinkLocalOf(owner) || ip.GetDestination().IsMulticast());
+    if (!ok && ip.GetHopLimit() < 64) ok = !m_relayCheck.IsNull() && m_relayCheck(src, owner);
+    if (m_metrics) m_metrics->NoteSaviCheck(!ok);
+    if (ok) return;
+    SaviTag tag;
+    tag.sender = owner;
+    p->AddByteTag(tag);
+  }
+
+  std::unordered_map<uint64_t, Ipv6Address> m_bound;
+  Callback<bool, Ipv6Address, Ipv6Address> m_relayCheck;
+  MetricsCollector *m_metrics{nullptr};
+};
+
+// ---------------- Ground truth ----------------
+// Byte tag on every packet an attacker application builds, so detector
+// verdicts can be scored. Nothing on the packet's path reads it.
+class AttackTag : public Tag {
+public:
+  static TypeId GetTypeId() {
+    static TypeId tid = TypeId("AttackTag")
+      .SetParent<Tag>()
+      .AddConstructor<AttackTag>();
+    return tid;
+  }
+  TypeId GetInstanceTypeId() const override { return GetTypeId(); }
+  uint32_t GetSerializedSize() const override { return 0; }
+  void Serialize(TagBuffer) const override {}
+  void Deserialize(TagBuffer) override {}
+  void Print(std::ostream &os) const override { os << "attack"; }
+};
+
+static bool IsAttack(Ptr<const Packet> p) {
+  AttackTag t;
+  return p->FindFirstMatchingByteTag(t);
+}
+
 // ---------------- Mitigator (root) ----------------
 class Mitigator : public Application {
 public:
@@ -161,45 +1334,114 @@ public:
   void Setup(uint16_t port, uint32_t threshold, double windowSec, MetricsCollector *m) {
     m_port = port; m_threshold = threshold; m_window = Seconds(windowSec); m_metrics = m;
   }
+  // Forget sources idle for longer than ttl (and lift their block), so
+  // rebooted or re-addressed nodes do not leave state behind forever.
+  void SetStateTtl(Time ttl) { m_stateTtl = ttl; }
+  // Hand packets that pass the rate check on (e.g. DAOs to the RPL agent).
+  void SetAcceptCallback(Callback<void, Ptr<Packet>, Ipv6Address> cb) { m_accept = cb; }
+  // Told about each newly blocked source and how many links its packet crossed.
+  void SetBlockCallback(Callback<void, Ipv6Address, uint32_t> cb) { m_onBlock = cb; }
+  // Provisioned known-good sources skip detection. One in sampleEvery of
+  // each source's packets still goes through it; n samples in the window
+  // stand for at least (n - 1) * sampleEvery + 1 packets, so a compromised
+  // insider is caught and then loses its entry.
+  void SetAllowlist(const std::vector<Ipv6Address> &sources, uint32_t sampleEvery) {
+    for (const Ipv6Address &a : sources) m_allow.emplace(a, 0);
+    m_sampleEvery = std::max(1u, sampleEvery);
+  }
 
 private:
   void StartApplication() override {
     m_sock = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
     m_sock->Bind(Inet6SocketAddress(Ipv6Address::GetAny(), m_port));
     m_sock->SetRecvCallback(MakeCallback(&Mitigator::HandleRead, this));
+    if (!m_onBlock.IsNull()) m_sock->SetIpv6RecvHopLimit(true);
     g_mitigationEnabled = true;
+    if (m_stateTtl.IsStrictlyPositive()) m_purge = Simulator::Schedule(m_stateTtl, &Mitigator::Purge, this);
   }
   void StopApplication() override { 
     if (m_sock) m_sock->Close(); 
+    if (m_purge.IsPending()) Simulator::Cancel(m_purge);
     g_mitigationEnabled = false;
   }
 
+  void Purge() {
+    Time now = Simulator::Now();
+    uint32_t purged = 0;
+    for (auto it = m_state.begin(); it != m_state.end();) {
+      if (it->second.arrivals.empty() || now - it->second.arrivals.back() > m_stateTtl) {
+        g_blockedSources.erase(it->first);
+        it = m_state.erase(it);
+        purged++;
+      } else {
+        ++it;
+      }
+    }
+    if (m_metrics) m_metrics->NoteDetectorState(m_state.size(), purged);
+    m_purge = Simulator::Schedule(m_stateTtl, &Mitigator::Purge, this);
+  }
+
   void HandleRead(Ptr<Socket> s) {
     Address from;
     Ptr<Packet> p;
     while ((p = s->RecvFrom(from))) {
       if (!Inet6SocketAddress::IsMatchingType(from)) continue;
       Ipv6Address src = Inet6SocketAddress::ConvertFrom(from).GetIpv6();
+      // spoofed source: never accepted, counted against the real sender
+      SaviTag savi;
+      bool spoofed = p->FindFirstMatchingByteTag(savi);
+      if (spoofed) {
+        src = savi.sender;
+        if (m_metrics) m_metrics->NoteSaviDrop();
+      }
+      auto allow = spoofed ? m_allow.end() : m_allow.find(src);
+      bool allowed = allow != m_allow.end();
+      if (allowed && ++allow->second % m_sampleEvery != 0) {
+        if (m_metrics) { m_metrics->NoteControlRx(IsAttack(p)); m_metrics->NoteAllowlist(false, false); }
+        if (!m_accept.IsNull()) m_accept(p, src);
+        continue;
+      }
       Time now = Simulator::Now();
       auto &dq = m_state[src].arrivals;
       dq.push_back(now);
       
       while (!dq.empty() && now - dq.front() > m_window) dq.pop_front();
       
-      if (dq.size() <= m_threshold) {
-        if (m_metrics) m_metrics->NoteControlRx();
+      uint64_t count = allowed ? (dq.size() - 1) * m_sampleEvery + 1 : dq.size();
+      bool over = count > m_threshold;
+      if (allowed && m_metrics) m_metrics->NoteAllowlist(true, over);
+      if (allowed && over) m_allow.erase(src);
+      bool attack = IsAttack(p);
+      if (!over && spoofed) {
+        if (m_metrics) m_metrics->NoteControlDropped(attack);
+      } else if (!over) {
+        if (m_metrics) m_metrics->NoteControlRx(attack);
         // Remove from blocked list if present
         g_blockedSources.erase(src);
+        if (!m_accept.IsNull()) m_accept(p, src);
       } else {
-        if (m_metrics) m_metrics->NoteControlDropped();
+        if (m_metrics) m_metrics->NoteControlDropped(attack);
         // Add to blocked list to prevent future packets at MAC layer
-        g_blockedSources.insert(src);
+        if (g_blockedSources.insert(src).second) {
+          if (g_capture) g_capture->Trigger("block");
+          if (g_churn) g_churn->OnBlock(src);
+          if (g_mobility) g_mobility->OnBlock(src);
+          SocketIpv6HopLimitTag hl;
+          if (!m_onBlock.IsNull()) m_onBlock(src, p->PeekPacketTag(hl) ? 65u - std::min<uint32_t>(hl.GetHopLimit(), 64) : 1u);
+        }
       }
+      if (m_metrics) m_metrics->NoteDetectorState(m_state.size(), 0);
     }
   }
 
   struct SState { std::deque<Time> arrivals; };
   std::map<Ipv6Address, SState> m_state;
+  Time m_stateTtl{Seconds(0)};
+  EventId m_purge;
+  Callback<void, Ptr<Packet>, Ipv6Address> m_accept;
+  Callback<void, Ipv6Address, uint32_t> m_onBlock;
+  std::unordered_map<Ipv6Address, uint64_t, Ipv6AddressHash> m_allow;   // source -> packets seen, for sampling
+  uint32_t m_sampleEvery{20};
 
   Ptr<Socket> m_sock;
   uint16_t m_port{0};
@@ -223,17 +1465,35 @@ public:
     m_metrics = m;
     m_interval = (pps > 0) ? Seconds(1.0 / pps) : Seconds(0.01);
   }
+  // Build each flood packet with gen instead of sending zero payloads.
+  void SetPayloadGenerator(Callback<Ptr<Packet>> gen) { m_gen = gen; }
+  // Send from n extra addresses in the node's prefix, one after another,
+  // so per-source detector state never fills up.
+  void SetAddressRotation(uint32_t n) { m_rotate = n; }
 
 private:
   void StartApplication() override {
     m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
     m_socket->Connect(Address(m_dest));
+    Ptr<Ipv6> ipv6 = GetNode()->GetObject<Ipv6>();
+    for (uint32_t k = 0; k < m_rotate; ++k) {
+      uint8_t b[16];
+      ipv6->GetAddress(1, 1).GetAddress().GetBytes(b);
+      for (uint32_t j = 8; j < 16; ++j) b[j] = static_cast<uint8_t>(rand());
+      Ipv6Address fake(b);
+      ipv6->AddAddress(1, Ipv6InterfaceAddress(fake, Ipv6Prefix(64)));
+      Ptr<Socket> sock = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+      sock->Bind(Inet6SocketAddress(fake, 0));
+      sock->Connect(Address(m_dest));
+      m_rotating.push_back(sock);
+    }
     m_event = Simulator::Schedule(Seconds(m_startTime), &SmartAttacker::SendPacket, this);
   }
   
   void StopApplication() override {
     if (m_event.IsPending()) Simulator::Cancel(m_event);
     if (m_socket) m_socket->Close();
+    for (Ptr<Socket> s : m_rotating) s->Close();
   }
   
   void SendPacket() {
@@ -254,6 +1514,7 @@ private:
           }
           // Random drop: only send 10% of packets when blocked
           if (rand() % 10 != 0) {
+            if (m_metrics) m_metrics->NoteControlSuppressed();
             m_event = Simulator::Schedule(m_interval, &SmartAttacker::SendPacket, this);
             return;
           }
@@ -263,8 +1524,11 @@ private:
       }
     }
     
-    Ptr<Packet> p = Create<Packet>(m_pktBytes);
-    int result = m_socket->Send(p);
+    Ptr<Packet> p = m_gen.IsNull() ? Create<Packet>(m_pktBytes) : m_gen();
+    if (g_llsec) g_llsec->Pad(p);   // an insider holds the network key
+    p->AddByteTag(AttackTag());
+    Ptr<Socket> sock = m_rotating.empty() ? m_socket : m_rotating[m_next++ % m_rotating.size()];
+    int result = sock->Send(p);
     
     if (result >= 0) {
       if (m_metrics) m_metrics->NoteControlTx();
@@ -283,10 +1547,1299 @@ private:
   Time m_interval{Seconds(0.01)};
   MetricsCollector *m_metrics;
   bool m_blocked;
+  Callback<Ptr<Packet>> m_gen;
+  uint32_t m_rotate{0};
+  uint32_t m_next{0};
+  std::vector<Ptr<Socket>> m_rotating;
 };
 
-// ---------------- main ----------------
-int main(int argc, char *argv[]) {
+// ---------------- Flow statistics ----------------
+// Non-empty histogram bins as "start_ms:count;..." so one flow fits on a line.
+static std::string CompactHistogram(const Histogram &h) {
+  std::ostringstream os;
+  for (uint32_t i = 0; i < h.GetNBins(); ++i) {
+    if (h.GetBinCount(i) == 0) continue;
+    if (os.tellp() > 0) os << ";";
+    os << h.GetBinStart(i) * 1000.0 << ":" << h.GetBinCount(i);
+  }
+  return os.str();
+}
+
+// Per-flow IP-layer view of every flow (data, control and attack alike),
+// independent of what the applications report to MetricsCollector.
+static void WriteFlowCsv(Ptr<FlowMonitor> monitor, Ptr<Ipv6FlowClassifier> cls,
+                         const std::map<uint16_t, std::string> &portClass, const std::string &prefix) {
+  monitor->CheckForLostPackets();
+  std::filesystem::create_directories("results");
+  std::ofstream f("results/" + prefix + "_flows.csv");
+  f << "flow,class,src,dst,proto,sport,dport,tx_pkts,rx_pkts,tx_bytes,rx_bytes,lost_pkts,"
+       "avg_delay_s,avg_jitter_s,delay_hist_ms,jitter_hist_ms\n";
+  for (const auto &kv : monitor->GetFlowStats()) {
+    const FlowMonitor::FlowStats &st = kv.second;
+    Ipv6FlowClassifier::FiveTuple t = cls->FindFlow(kv.first);
+    auto it = portClass.find(t.destinationPort);
+    if (it == portClass.end()) it = portClass.find(t.sourcePort);
+    double avgDelay = (st.rxPackets > 0) ? st.delaySum.GetSeconds() / st.rxPackets : 0.0;
+    double avgJitter = (st.rxPackets > 1) ? st.jitterSum.GetSeconds() / (st.rxPackets - 1) : 0.0;
+    f << kv.first << "," << (it != portClass.end() ? it->second : "other") << ","
+      << t.sourceAddress << "," << t.destinationAddress << "," << static_cast<uint32_t>(t.protocol) << ","
+      << t.sourcePort << "," << t.destinationPort << ","
+      << st.txPackets << "," << st.rxPackets << "," << st.txBytes << "," << st.rxBytes << ","
+      << st.lostPackets << "," << avgDelay << "," << avgJitter << ","
+      << CompactHistogram(st.delayHistogram) << "," << CompactHistogram(st.jitterHistogram) << "\n";
+  }
+}
+
+// ---------------- Radio environment ----------------
+// Node index from the MAC addresses assigned in main (short = ext = i + 1).
+static int32_t MacSourceNode(const LrWpanMacHeader &hdr) {
+  uint64_t id = 0;
+  if (hdr.GetSrcAddrMode() == LrWpanMacHeader::SHORTADDR) {
+    uint8_t b[2]; hdr.GetShortSrcAddr().CopyTo(b);
+    id = (static_cast<uint64_t>(b[0]) << 8) | b[1];
+  } else if (hdr.GetSrcAddrMode() == LrWpanMacHeader::EXTADDR) {
+    uint8_t b[8]; hdr.GetExtSrcAddr().CopyTo(b);
+    for (uint8_t x : b) id = (id << 8) | x;
+  }
+  return (id > 0) ? static_cast<int32_t>(id - 1) : -1;
+}
+
+// Log-normal shadowing drawn once per unordered node pair, so a link keeps
+// its offset for the whole run (unlike per-packet random loss).
+class LinkShadowingLossModel : public PropagationLossModel {
+public:
+  static TypeId GetTypeId() {
+    static TypeId tid = TypeId("LinkShadowingLossModel")
+      .SetParent<PropagationLossModel>()
+      .SetGroupName("Propagation")
+      .AddConstructor<LinkShadowingLossModel>();
+    return tid;
+  }
+  LinkShadowingLossModel() : m_normal(CreateObject<NormalRandomVariable>()) {}
+  void SetSigma(double sigmaDb) { m_normal->SetAttribute("Variance", DoubleValue(sigmaDb * sigmaDb)); }
+
+private:
+  double DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override {
+    uint32_t ia = a->GetObject<Node>()->GetId(), ib = b->GetObject<Node>()->GetId();
+    std::pair<uint32_t, uint32_t> key = std::minmax(ia, ib);
+    auto it = m_offsetDb.find(key);
+    if (it == m_offsetDb.end()) it = m_offsetDb.emplace(key, m_normal->GetValue()).first;
+    return txPowerDbm - it->second;
+  }
+  int64_t DoAssignStreams(int64_t stream) override { m_normal->SetStream(stream); return 1; }
+
+  Ptr<NormalRandomVariable> m_normal;
+  mutable std::map<std::pair<uint32_t, uint32_t>, double> m_offsetDb;
+};
+NS_OBJECT_ENSURE_REGISTERED(LinkShadowingLossModel);
+
+// "default" keeps the LrWpanHelper channel; otherwise path loss is one of
+// logdistance | shadowing (log-distance + per-link log-normal) | indoor
+// (ITU-R P.1238), optionally followed by per-packet Rayleigh/Nakagami fading.
+static Ptr<SpectrumChannel> BuildChannel(const std::string &model, double exponent, double shadowSigmaDb,
+                                         const std::string &fading, double nakagamiM) {
+  if (model == "default" && fading == "none") return nullptr;
+  Ptr<SingleModelSpectrumChannel> ch = CreateObject<SingleModelSpectrumChannel>();
+  if (model == "indoor") {
+    Ptr<ItuR1238PropagationLossModel> itu = CreateObject<ItuR1238PropagationLossModel>();
+    itu->SetAttribute("Frequency", DoubleValue(2.405e9));
+    ch->AddPropagationLossModel(itu);
+  } else {
+    NS_ABORT_MSG_UNLESS(model == "default" || model == "logdistance" || model == "shadowing",
+                        "Unknown propagation model " << model);
+    Ptr<LogDistancePropagationLossModel> ld = CreateObject<LogDistancePropagationLossModel>();
+    if (model != "default") ld->SetAttribute("Exponent", DoubleValue(exponent));
+    ch->AddPropagationLossModel(ld);
+    if (model == "shadowing") {
+      Ptr<LinkShadowingLossModel> sh = CreateObject<LinkShadowingLossModel>();
+      sh->SetSigma(shadowSigmaDb);
+      ch->AddPropagationLossModel(sh);
+    }
+  }
+  if (fading != "none") {
+    NS_ABORT_MSG_UNLESS(fading == "rayleigh" || fading == "nakagami", "Unknown fading model " << fading);
+    double m = (fading == "rayleigh") ? 1.0 : nakagamiM;
+    Ptr<NakagamiPropagationLossModel> nk = CreateObject<NakagamiPropagationLossModel>();
+    nk->SetAttribute("m0", DoubleValue(m));
+    nk->SetAttribute("m1", DoubleValue(m));
+    nk->SetAttribute("m2", DoubleValue(m));
+    ch->AddPropagationLossModel(nk);
+  }
+  ch->SetPropagationDelayModel(CreateObject<ConstantSpeedPropagationDelayModel>());
+  return ch;
+}
+
+// Per directed link packet reception ratio: data frames decoded at b from a
+// over every transmission attempt by a (retries included).
+class LinkStats {
+public:
+  void Attach(Ptr<LrWpanNetDevice> dev, uint32_t nodeId) {
+    dev->GetMac()->TraceConnectWithoutContext("PromiscSniffer", MakeBoundCallback(&LinkStats::OnFrame, this, nodeId));
+  }
+
+  void WriteCsv(const std::string &prefix, const NodeContainer &nodes) {
+    std::filesystem::create_directories("results");
+    std::ofstream f("results/" + prefix + "_links.csv");
+    f << "src,dst,distance_m,tx,rx,prr\n";
+    for (const auto &kv : m_tx) {
+      uint32_t a = kv.first;
+      for (uint32_t b = 0; b < nodes.GetN(); ++b) {
+        if (b == a || a >= nodes.GetN()) continue;
+        auto it = m_rx.find({a, b});
+        uint64_t rx = (it != m_rx.end()) ? it->second : 0;
+        double d = CalculateDistance(nodes.Get(a)->GetObject<MobilityModel>()->GetPosition(),
+                                     nodes.Get(b)->GetObject<MobilityModel>()->GetPosition());
+        f << a << "," << b << "," << d << "," << kv.second << "," << rx << ","
+          << static_cast<double>(rx) / static_cast<double>(kv.second) << "\n";
+      }
+    }
+  }
+
+private:
+  static void OnFrame(LinkStats *self, uint32_t nodeId, Ptr<const Packet> p) {
+    LrWpanMacHeader hdr;
+    p->PeekHeader(hdr);
+    if (!hdr.IsData()) return;
+    int32_t src = MacSourceNode(hdr);
+    if (src < 0) return;
+    if (static_cast<uint32_t>(src) == nodeId) self->m_tx[nodeId]++;
+    else self->m_rx[{static_cast<uint32_t>(src), nodeId}]++;
+  }
+
+  std::map<uint32_t, uint64_t> m_tx;
+  std::map<std::pair<uint32_t, uint32_t>, uint64_t> m_rx;
+};
+
+// Attacker localization at the roots. Honest nodes report, per link-layer
+// sender they overhear, a smoothed SINR of its frames. When a Mitigator
+// blocks a source, the root resolves it to a sender, either from the
+// address binding or, if the address is unknown (rotated or spoofed), as
+// the sender heard most often over the last second. The strongest reporters
+// form the neighbourhood and give a SINR-weighted centroid. The hop count
+// of the blocked packet caps the estimate at hops * range from the root.
+class AttackLocalizer {
+public:
+  static constexpr uint32_t kNeighbourhood = 4;
+
+  void Setup(const NodeContainer &nodes, double range) { m_nodes = nodes; m_range = range; }
+  void Attach(Ptr<LrWpanNetDevice> dev, uint32_t nodeId) {
+    dev->GetPhy()->TraceConnectWithoutContext("PhyRxEnd", MakeBoundCallback(&AttackLocalizer::OnRx, this, nodeId));
+  }
+  void Bind(const Ipv6Address &addr, uint32_t nodeId) { m_bound[addr] = nodeId; }
+
+  // Block hook for the Mitigator at root r; hops counts links crossed.
+  static void OnBlock(AttackLocalizer *self, uint32_t r, Ipv6Address src, uint32_t hops) { self->Locate(r, src, hops); }
+
+  void WriteCsv(const std::string &prefix) {
+    std::filesystem::create_directories("results");
+    std::ofstream f("results/" + prefix + "_localization.csv");
+    f << "time_s,source,method,sender,hops,reporters,est_x,est_y,true_x,true_y,error_m,neighbourhood\n";
+    for (const Fix &x : m_fixes) {
+      f << x.t.GetSeconds() << "," << x.src << "," << x.method << "," << x.sender << "," << x.hops << ","
+        << x.reporters << "," << x.est.x << "," << x.est.y << "," << x.truth.x << "," << x.truth.y << ","
+        << CalculateDistance(x.est, x.truth) << "," << x.neighbourhood << "\n";
+    }
+  }
+
+private:
+  struct Report { double sinrDb{0.0}; uint64_t frames{0}; };
+  struct Fix {
+    Time t; Ipv6Address src; std::string method; int32_t sender; uint32_t hops; uint32_t reporters;
+    Vector est; Vector truth; std::string neighbourhood;
+  };
+
+  static void OnRx(AttackLocalizer *self, uint32_t nodeId, Ptr<const Packet> p, double sinr) {
+    LrWpanMacHeader hdr;
+    if (sinr <= 0.0 || p->PeekHeader(hdr) == 0 || !hdr.IsData()) return;
+    int32_t src = MacSourceNode(hdr);
+    if (src < 0 || static_cast<uint32_t>(src) == nodeId) return;
+    Report &r = self->m_reports[src][nodeId];
+    double db = 10.0 * std::log10(sinr);
+    r.sinrDb = r.frames ? 0.8 * r.sinrDb + 0.2 * db : db;   // tracks a moving sender
+    r.frames++;
+    std::deque<Time> &heard = self->m_heard[src];
+    heard.push_back(Simulator::Now());
+    while (Simulator::Now() - heard.front() > Seconds(1)) heard.pop_front();
+  }
+
+  Vector Position(uint32_t i) const { return m_nodes.Get(i)->GetObject<MobilityModel>()->GetPosition(); }
+
+  void Locate(uint32_t root, const Ipv6Address &src, uint32_t hops) {
+    Fix x{Simulator::Now(), src, "binding", -1, hops, 0, Vector(), Vector(), ""};
+    auto b = m_bound.find(src);
+    if (b != m_bound.end()) {
+      x.sender = static_cast<int32_t>(b->second);
+    } else {
+      x.method = "loudest";
+      size_t most = 0;
+      for (const auto &kv : m_heard) {
+        if (kv.second.size() > most && Simulator::Now() - kv.second.back() <= Seconds(1)) { most = kv.second.size(); x.sender = kv.first; }
+      }
+    }
+    if (x.sender < 0) return;
+    std::vector<std::pair<double, uint32_t>> strongest;
+    for (const auto &kv : m_reports[x.sender]) strongest.push_back({kv.second.sinrDb, kv.first});
+    std::sort(strongest.rbegin(), strongest.rend());
+    if (strongest.size() > kNeighbourhood) strongest.resize(kNeighbourhood);
+    x.reporters = static_cast<uint32_t>(m_reports[x.sender].size());
+    Vector c = Position(root);
+    if (!strongest.empty()) {
+      double wsum = 0.0;
+      Vector acc;
+      std::ostringstream nb;
+      for (const auto &s : strongest) {
+        double w = std::pow(10.0, s.first / 20.0);
+        Vector p = Position(s.second);
+        acc.x += w * p.x; acc.y += w * p.y; wsum += w;
+        nb << (nb.tellp() > 0 ? ";" : "") << s.second;
+      }
+      c = Vector(acc.x / wsum, acc.y / wsum, 0.0);
+      x.neighbourhood = nb.str();
+    }
+    Vector r = Position(root);
+    double d = CalculateDistance(c, r), cap = std::max(1u, hops) * m_range;
+    if (d > cap) c = Vector(r.x + (c.x - r.x) * cap / d, r.y + (c.y - r.y) * cap / d, 0.0);
+    x.est = c;
+    x.truth = Position(x.sender);
+    m_fixes.push_back(x);
+  }
+
+  NodeContainer m_nodes;
+  double m_range{30.0};
+  std::map<int32_t, std::map<uint32_t, Report>> m_reports;
+  std::map<int32_t, std::deque<Time>> m_heard;
+  std::map<Ipv6Address, uint32_t> m_bound;
+  std::vector<Fix> m_fixes;
+};
+
+// 2001:db8:0:<pan>::/64 for PAN / channel index pan.
+static Ipv6Address PanPrefix(uint32_t pan) {
+  std::ostringstream os;
+  os << "2001:db8:0:" << std::hex << pan << "::";
+  return Ipv6Address(os.str().c_str());
+}
+
+// 2.4 GHz O-QPSK channel for PAN index pan, spread 25 MHz apart first.
+static uint8_t PanChannel(uint32_t pan) { return static_cast<uint8_t>(11 + (5 * pan) % 16); }
+
+// Offered load per 802.15.4 channel: summed PHY transmit airtime.
+class ChannelStats {
+public:
+  void Attach(Ptr<LrWpanNetDevice> dev, uint32_t pan) {
+    uint32_t slot = m_pan.size();
+    m_pan.push_back(pan);
+    m_begin.push_back(Seconds(0));
+    if (m_airtime.size() <= pan) { m_airtime.resize(pan + 1, Seconds(0)); m_frames.resize(pan + 1, 0); m_radios.resize(pan + 1, 0); }
+    m_radios[pan]++;
+    dev->GetPhy()->TraceConnectWithoutContext("PhyTxBegin", MakeBoundCallback(&ChannelStats::OnTxBegin, this, slot));
+    dev->GetPhy()->TraceConnectWithoutContext("PhyTxEnd", MakeBoundCallback(&ChannelStats::OnTxEnd, this, slot));
+  }
+
+  void WriteCsv(const std::string &prefix, Time duration) {
+    std::filesystem::create_directories("results");
+    std::ofstream f("results/" + prefix + "_channels.csv");
+    f << "pan,channel,radios,frames,airtime_s,load\n";
+    for (uint32_t c = 0; c < m_airtime.size(); ++c) {
+      f << c << "," << static_cast<uint32_t>(PanChannel(c)) << "," << m_radios[c] << "," << m_frames[c] << ","
+        << m_airtime[c].GetSeconds() << "," << m_airtime[c].GetSeconds() / duration.GetSeconds() << "\n";
+    }
+  }
+
+private:
+  static void OnTxBegin(ChannelStats *self, uint32_t slot, Ptr<const Packet>) { self->m_begin[slot] = Simulator::Now(); }
+  static void OnTxEnd(ChannelStats *self, uint32_t slot, Ptr<const Packet>) {
+    uint32_t pan = self->m_pan[slot];
+    self->m_airtime[pan] += Simulator::Now() - self->m_begin[slot];
+    self->m_frames[pan]++;
+  }
+
+  std::vector<uint32_t> m_pan;
+  std::vector<Time> m_begin;
+  std::vector<Time> m_airtime;
+  std::vector<uint64_t> m_frames;
+  std::vector<uint32_t> m_radios;
+};
+
+// ---------------- CompactRouteTable ----------------
+// Non-storing root table. A target is matched on its /64 first (a short
+// list, one prefix per PAN) and then on its 64-bit interface ID in a sorted
+// flat vector, 24 bytes per route. New routes go to a small sorted tail of
+// about sqrt(n) entries that is merged in when full, so a DAO burst costs
+// amortised O(sqrt n) short moves per insert instead of a full memmove.
+class CompactRouteTable {
+public:
+  struct Entry {
+    uint64_t iid;
+    uint64_t parentIid;
+    uint32_t expiresMs;
+    uint16_t prefix;
+    uint16_t parentPrefix;
+  };
+  static const size_t kTailMin = 64;
+
+  // Returns true if target was not in the table yet.
+  bool Insert(const Ipv6Address &target, const Ipv6Address &parent, Time expires) {
+    Entry e{Iid(target), Iid(parent), static_cast<uint32_t>(expires.GetMilliSeconds()),
+            PrefixIndex(target), PrefixIndex(parent)};
+    if (Entry *cur = const_cast<Entry*>(Locate(e.prefix, e.iid))) { *cur = e; return false; }
+    m_tail.insert(std::lower_bound(m_tail.begin(), m_tail.end(), e, &CompactRouteTable::Less), e);
+    size_t cap = std::max(kTailMin, static_cast<size_t>(std::sqrt(static_cast<double>(m_sorted.size()))));
+    if (m_tail.size() >= cap) Merge();
+    return true;
+  }
+  const Entry *Find(const Ipv6Address &target) const {
+    int32_t px = FindPrefix(target);
+    return (px < 0) ? nullptr : Locate(static_cast<uint16_t>(px), Iid(target));
+  }
+  // Drop routes past their lifetime; returns the removed targets.
+  std::vector<Ipv6Address> Expire(Time now) {
+    Merge();
+    std::vector<Ipv6Address> gone;
+    uint64_t ms = static_cast<uint64_t>(now.GetMilliSeconds());
+    auto keep = std::remove_if(m_sorted.begin(), m_sorted.end(), [&](const Entry &e) {
+      if (e.expiresMs > ms) return false;
+      gone.push_back(Target(e));
+      return true;
+    });
+    m_sorted.erase(keep, m_sorted.end());
+    return gone;
+  }
+  template <typename F> void ForEach(F f) const {
+    for (const Entry &e : m_sorted) f(e);
+    for (const Entry &e : m_tail) f(e);
+  }
+  size_t Size() const { return m_sorted.size() + m_tail.size(); }
+  size_t Bytes() const { return Size() * sizeof(Entry) + m_prefixes.size() * sizeof(uint64_t); }
+  Ipv6Address Target(const Entry &e) const { return Compose(e.prefix, e.iid); }
+  Ipv6Address Parent(const Entry &e) const { return Compose(e.parentPrefix, e.parentIid); }
+
+private:
+  static bool Less(const Entry &a, const Entry &b) {
+    return a.iid < b.iid || (a.iid == b.iid && a.prefix < b.prefix);
+  }
+  static uint64_t Half(const Ipv6Address &a, uint32_t off) {
+    uint8_t b[16];
+    a.GetBytes(b);
+    uint64_t v = 0;
+    for (uint32_t k = 0; k < 8; ++k) v = (v << 8) | b[off + k];
+    return v;
+  }
+  static uint64_t Iid(const Ipv6Address &a) { return Half(a, 8); }
+  int32_t FindPrefix(const Ipv6Address &a) const {
+    uint64_t p = Half(a, 0);
+    for (size_t k = 0; k < m_prefixes.size(); ++k) {
+      if (m_prefixes[k] == p) return static_cast<int32_t>(k);
+    }
+    return -1;
+  }
+  uint16_t PrefixIndex(const Ipv6Address &a) {
+    int32_t k = FindPrefix(a);
+    if (k >= 0) return static_cast<uint16_t>(k);
+    m_prefixes.push_back(Half(a, 0));
+    return static_cast<uint16_t>(m_prefixes.size() - 1);
+  }
+  Ipv6Address Compose(uint16_t prefix, uint64_t iid) const {
+    uint8_t b[16];
+    for (uint32_t k = 0; k < 8; ++k) {
+      b[k] = static_cast<uint8_t>(m_prefixes[prefix] >> (56 - 8 * k));
+      b[8 + k] = static_cast<uint8_t>(iid >> (56 - 8 * k));
+    }
+    return Ipv6Address(b);
+  }
+  const Entry *Locate(uint16_t prefix, uint64_t iid) const {
+    Entry key{iid, 0, 0, prefix, 0};
+    for (const std::vector<Entry> *v : {&m_sorted, &m_tail}) {
+      auto it = std::lower_bound(v->begin(), v->end(), key, &CompactRouteTable::Less);
+      if (it != v->end() && it->iid == iid && it->prefix == prefix) return &*it;
+    }
+    return nullptr;
+  }
+  void Merge() {
+    // merge from the back: no scratch buffer, entries below the tail stay put
+    size_t i = m_sorted.size(), j = m_tail.size(), k = i + j;
+    m_sorted.resize(k);
+    while (j > 0) {
+      if (i > 0 && Less(m_tail[j - 1], m_sorted[i - 1])) m_sorted[--k] = m_sorted[--i];
+      else m_sorted[--k] = m_tail[--j];
+    }
+    m_tail.clear();
+  }
+
+  std::vector<uint64_t> m_prefixes;
+  std::vector<Entry> m_sorted;
+  std::vector<Entry> m_tail;
+};
+
+// Insert / lookup cost of the compact table against the std::map keyed on
+// full addresses it replaced, at each table size. Targets are spread over
+// a few /64s like a multi-PAN root would see.
+static void RunRouteBenchmark(const std::string &sizes, const std::string &prefix) {
+  std::filesystem::create_directories("results");
+  std::ofstream f("results/" + prefix + "_route_bench.csv");
+  f << "structure,routes,insert_ns,lookup_ns,bytes_per_route\n";
+  std::mt19937_64 rng(1);
+  std::stringstream ss(sizes);
+  std::string tok;
+  while (std::getline(ss, tok, ',')) {
+    uint32_t n = static_cast<uint32_t>(std::stoul(tok));
+    std::vector<Ipv6Address> targets;
+    for (uint32_t i = 0; i < n; ++i) {
+      uint8_t b[16];
+      PanPrefix(i % 4).GetBytes(b);
+      uint64_t iid = rng();
+      for (uint32_t k = 0; k < 8; ++k) b[8 + k] = static_cast<uint8_t>(iid >> (56 - 8 * k));
+      targets.push_back(Ipv6Address(b));
+    }
+    std::vector<uint32_t> order(n);
+    for (uint32_t i = 0; i < n; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    auto nsPer = [n](std::chrono::steady_clock::time_point t0) {
+      return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+    };
+    uint64_t hits = 0;
+
+    std::map<Ipv6Address, Ipv6Address> ordered;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; ++i) ordered[targets[i]] = targets[(i + 1) % n];
+    double mapInsert = nsPer(t0);
+    t0 = std::chrono::steady_clock::now();
+    for (uint32_t i : order) hits += ordered.count(targets[i]);
+    double mapLookup = nsPer(t0);
+    // red-black node: three pointers and a colour word around the pair
+    f << "std_map," << n << "," << mapInsert << "," << mapLookup << "," << 32 + 2 * sizeof(Ipv6Address) << "\n";
+
+    CompactRouteTable compact;
+    t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; ++i) compact.Insert(targets[i], targets[(i + 1) % n], Seconds(60));
+    double flatInsert = nsPer(t0);
+    compact.Expire(Seconds(0));   // flushes the tail so lookups see the steady state
+    t0 = std::chrono::steady_clock::now();
+    for (uint32_t i : order) hits += (compact.Find(targets[i]) != nullptr);
+    double flatLookup = nsPer(t0);
+    f << "compact," << n << "," << flatInsert << "," << flatLookup << ","
+      << static_cast<double>(compact.Bytes()) / n << "\n";
+    NS_ABORT_MSG_UNLESS(hits == 2ull * n, "route benchmark lost entries");
+  }
+}
+
+// ---------------- RplAgent ----------------
+// Minimal RPL-like control plane over UDP. DIOs go to all-nodes link-local
+// multicast on a trickle timer; each node keeps a neighbour table with ETX
+// estimated from MAC ACK outcomes and picks its preferred parent with MRHOF
+// (RFC 6719). Ranks are in ETX * 128 units with the root at 128. The chosen
+// parent becomes the next hop of a host route towards the DODAG root.
+enum : uint8_t { kRplDis = 0, kRplDio = 1, kRplDao = 2 };
+// Mode of operation (RFC 6550 MOP values) for downward routes.
+enum : uint8_t { kMopNone = 0xff, kMopNonStoring = 1, kMopStoring = 2 };
+enum : uint8_t { kDioAttackNone = 0, kDioAttackVersion = 1, kDioAttackRank = 2 };
+
+struct RplHdr {
+  uint8_t type;
+  uint8_t version;
+  uint16_t rank;
+  uint16_t lladdr;      // sender MAC short address, keys the neighbour table
+  uint8_t dodag[16];
+  uint8_t origin[16];   // sender global address
+} __attribute__((packed));
+
+// DAO: fixed part followed by nTargets (target, transit parent) pairs.
+struct RplDao {
+  uint8_t type;
+  uint8_t seq;
+  uint16_t lifetime;    // seconds
+  uint8_t nTargets;
+} __attribute__((packed));
+
+struct RplDaoTarget {
+  uint8_t target[16];
+  uint8_t parent[16];   // transit parent, used in non-storing mode
+} __attribute__((packed));
+
+// Storing route entry as a constrained stack would lay it out:
+// target + next-hop IID + lifetime.
+static const size_t kStoringEntryBytes = 16 + 8 + 2;
+static const size_t kMaxSourceRoute = 64;
+static const size_t kMaxDaoTargets = 8;
+static const uint32_t kUdpIpv6HeaderBytes = 8 + 40;
+static const size_t kMaxDisBuckets = 64;
+
+static const uint16_t kRootRank = 128;
+static const uint16_t kInfiniteRank = 0xffff;
+static const uint16_t kMaxLinkEtx = 4 * 128;
+static const uint16_t kParentSwitchThreshold = 192;
+
+static Ptr<Packet> MakeDao(uint8_t seq, uint16_t lifetime, const std::vector<std::pair<Ipv6Address, Ipv6Address>> &targets) {
+  RplDao h{};
+  h.type = kRplDao; h.seq = seq; h.lifetime = lifetime; h.nTargets = static_cast<uint8_t>(targets.size());
+  std::vector<uint8_t> buf(sizeof(h) + targets.size() * sizeof(RplDaoTarget));
+  std::memcpy(buf.data(), &h, sizeof(h));
+  for (size_t k = 0; k < targets.size(); ++k) {
+    RplDaoTarget t{};
+    targets[k].first.Serialize(t.target);
+    targets[k].second.Serialize(t.parent);
+    std::memcpy(buf.data() + sizeof(h) + k * sizeof(t), &t, sizeof(t));
+  }
+  return Create<Packet>(buf.data(), buf.size());
+}
+
+// Attacker payload: a well-formed DAO for a fresh, made-up target in the
+// root's prefix claiming the root as transit parent.
+static Ptr<Packet> ForgeDao(Ipv6Address root) {
+  uint8_t b[16];
+  root.GetBytes(b);
+  for (uint32_t k = 8; k < 16; ++k) b[k] = static_cast<uint8_t>(rand());
+  return MakeDao(static_cast<uint8_t>(rand()), 300, {{Ipv6Address(b), root}});
+}
+
+// Address -> (node, interface) over every node, built on first use and
+// rebuilt only when an address is missing or has moved (e.g. churn).
+static bool FindInterface(const Ipv6Address &addr, Ptr<Ipv6> &ipv6, uint32_t &ifIndex) {
+  static std::map<Ipv6Address, std::pair<uint32_t, uint32_t>> index;
+  auto lookup = [&]() {
+    auto it = index.find(addr);
+    if (it == index.end()) return false;
+    Ptr<Ipv6> ip = NodeList::GetNode(it->second.first)->GetObject<Ipv6>();
+    if (ip->GetInterfaceForAddress(addr) != static_cast<int32_t>(it->second.second)) return false;
+    ipv6 = ip; ifIndex = it->second.second;
+    return true;
+  };
+  if (lookup()) return true;
+  index.clear();
+  for (auto it = NodeList::Begin(); it != NodeList::End(); ++it) {
+    Ptr<Ipv6> ip = (*it)->GetObject<Ipv6>();
+    if (!ip) continue;
+    for (uint32_t i = 0; i < ip->GetNInterfaces(); ++i) {
+      for (uint32_t a = 0; a < ip->GetNAddresses(i); ++a) index[ip->GetAddress(i, a).GetAddress()] = {(*it)->GetId(), i};
+    }
+  }
+  return lookup();
+}
+
+// RFC 6554 SRH size for a path (first hop = IPv6 destination, the rest go
+// in the header), with CmprI / CmprE elision of prefix bytes shared with it.
+static uint32_t SrhBytes(const std::vector<Ipv6Address> &path) {
+  if (path.size() < 2) return 0;
+  uint8_t da[16];
+  path[0].GetBytes(da);
+  auto common = [&da](const Ipv6Address &a) {
+    uint8_t b[16];
+    a.GetBytes(b);
+    uint32_t n = 0;
+    while (n < 15 && b[n] == da[n]) n++;
+    return n;
+  };
+  uint32_t cmprI = 15;
+  for (size_t k = 1; k + 1 < path.size(); ++k) cmprI = std::min(cmprI, common(path[k]));
+  uint32_t cmprE = common(path.back());
+  uint32_t n = static_cast<uint32_t>(path.size() - 1);
+  uint32_t bytes = 8 + (n - 1) * (16 - cmprI) + (16 - cmprE);
+  return (bytes + 7) / 8 * 8;
+}
+
+class RplAgent : public Application {
+public:
+  RplAgent() = default;
+  void Setup(uint16_t port, bool isRoot, Time imin, uint32_t doublings, uint32_t k, MetricsCollector *m) {
+    m_port = port; m_isRoot = isRoot; m_imin = imin; m_doublings = doublings; m_k = k; m_metrics = m;
+  }
+  // Root only: above saturationPps packets/s at the IPv6 layer the root
+  // advertises its rank plus penalty so MRHOF moves children to other
+  // roots; it returns to normal below half that rate.
+  void SetLoadBalancing(double saturationPps, uint16_t penalty) {
+    m_saturationPps = saturationPps; m_loadPenalty = penalty;
+  }
+  // Non-root: also route this prefix (e.g. the backhaul) via the parent.
+  void SetUpwardPrefix(Ipv6Address prefix, Ipv6Prefix len) { m_upPrefix = prefix; m_upLen = len; m_hasUp = true; }
+  // Downward routes. Storing mode: every node keeps a table and DAOs go
+  // hop by hop to the parent. Non-storing mode: DAOs carry the transit
+  // parent straight to the root, which keeps the only table. A root takes
+  // its DAOs on ctrlPort through the Mitigator (see ReceiveDao).
+  void SetDownwardRoutes(uint8_t mop, Time daoPeriod, uint16_t ctrlPort) {
+    m_mop = mop; m_daoPeriod = daoPeriod; m_ctrlPort = ctrlPort;
+  }
+  void ReceiveDao(Ptr<Packet> p, Ipv6Address from) { HandleDao(p, from); }
+  // Root: told every target a DAO registers here, so the border can send
+  // downward traffic through the root whose DODAG the target joined.
+  void SetTargetCallback(Callback<void, Ipv6Address> cb) { m_onTarget = cb; }
+  // Storing mode: hold targets for delay and send them upward in combined
+  // DAOs of up to kMaxDaoTargets each (zero sends one DAO per target).
+  void SetDaoAggregation(Time delay) { m_daoAgg = delay; }
+  // Attacker only, from start on: kDioAttackVersion advertises the next
+  // DODAG version every period, forcing a global repair each time;
+  // kDioAttackRank advertises a rank just below the root's children and
+  // stops forwarding, sinking the traffic it attracts.
+  void SetDioAttack(uint8_t mode, Time start, Time period) {
+    m_dioAttack = mode; m_attackStart = start; m_attackPeriod = period;
+  }
+  // Attacker only: multicast DIS at pps from start on; every DIS resets
+  // the trickle timer of each neighbour that hears it.
+  void SetDisFlood(double pps, Time start) { m_disPps = pps; m_disStart = start; }
+  // Accept at most pps DIS per neighbour (burst of two) before they may
+  // reset trickle. A token bucket per sender keeps the state O(1) each;
+  // past kMaxDisBuckets senders share one bucket so spoofing stays bounded.
+  void SetDisRateLimit(double pps) { m_disLimitPps = pps; }
+  // Root: does the downward route to src leave through sender? Without
+  // downward routes nothing vouches for the relay, so it is refused.
+  bool RoutesVia(Ipv6Address src, Ipv6Address sender) {
+    if (m_mop == kMopStoring) {
+      auto it = m_routes.find(src);
+      return it != m_routes.end() && it->second.via == LinkLocalOf(sender);
+    }
+    if (m_mop == kMopNonStoring) {
+      std::vector<Ipv6Address> path;
+      return SourceRoute(src, path) && path[0] == sender;
+    }
+    return false;
+  }
+
+private:
+  struct Neighbour {
+    Ipv6Address ll;
+    Ipv6Address global;
+    Ipv6Address dodag;
+    uint16_t rank{kInfiniteRank};
+    uint8_t version{0};
+    uint16_t etx{2 * 128};    // RFC 6719 initial guess before any ACK outcome
+    uint32_t attempts{0};
+    Time lastHeard;
+  };
+  struct StoredRoute { Ipv6Address via; uint32_t ifIndex; Time expires; };
+  struct DisBucket { double tokens; Time last; };
+  struct Plumbing {
+    std::vector<std::pair<Ptr<Ipv6>, uint32_t>> hops;   // hops holding a plumbed route
+    std::vector<Ipv6Address> via;                       // transit nodes on the path
+  };
+
+  void StartApplication() override {
+    Ptr<Node> node = GetNode();
+    m_ipv6 = node->GetObject<Ipv6>();
+    m_self = static_cast<uint16_t>(node->GetId() + 1);
+    m_rank = m_isRoot ? kRootRank : kInfiniteRank;
+
+    m_rx = Socket::CreateSocket(node, UdpSocketFactory::GetTypeId());
+    m_rx->Bind(Inet6SocketAddress(Ipv6Address::GetAny(), m_port));
+    m_rx->SetRecvCallback(MakeCallback(&RplAgent::HandleRead, this));
+    for (uint32_t i = 1; i < m_ipv6->GetNInterfaces(); ++i) {
+      if (!DynamicCast<SixLowPanNetDevice>(m_ipv6->GetNetDevice(i))) continue;   // skip backhaul
+      Ptr<Socket> tx = Socket::CreateSocket(node, UdpSocketFactory::GetTypeId());
+      tx->Bind(Inet6SocketAddress(Ipv6Address::GetAny(), 0));
+      tx->BindToNetDevice(m_ipv6->GetNetDevice(i));
+      m_tx.push_back(tx);
+      m_txIf.push_back(i);
+    }
+    for (uint32_t d = 0; d < node->GetNDevices(); ++d) {
+      Ptr<LrWpanNetDevice> dev = DynamicCast<LrWpanNetDevice>(node->GetDevice(d));
+      if (!dev) continue;
+      dev->GetMac()->TraceConnectWithoutContext("MacTx", MakeBoundCallback(&RplAgent::OnMacTx, this));
+      dev->GetMac()->TraceConnectWithoutContext("MacTxOk", MakeBoundCallback(&RplAgent::OnMacTxOk, this));
+      dev->GetMac()->TraceConnectWithoutContext("MacTxDrop", MakeBoundCallback(&RplAgent::OnMacTxDrop, this));
+    }
+    if (m_isRoot) {
+      for (uint32_t i : m_txIf) {
+        if (m_metrics) m_metrics->NoteRootAddress(node->GetId(), GlobalAddress(i));
+      }
+      m_ipv6->TraceConnectWithoutContext("Rx", MakeBoundCallback(&RplAgent::OnL3Rx, this));
+      if (m_mop == kMopNonStoring) m_ipv6->TraceConnectWithoutContext("Tx", MakeBoundCallback(&RplAgent::OnL3Tx, this));
+      m_loadCheck = Simulator::Schedule(Seconds(1), &RplAgent::CheckLoad, this);
+      ResetTrickle();
+    }
+    if (m_mop != kMopNone) m_daoTimer = Simulator::Schedule(m_daoPeriod * m_rand->GetValue(0.5, 1.0), &RplAgent::DaoTick, this);
+    if (m_dioAttack != kDioAttackNone) {
+      m_attackTick = Simulator::Schedule(std::max(Seconds(0), m_attackStart - Simulator::Now()), &RplAgent::AttackTick, this);
+    }
+    if (m_disPps > 0.0) {
+      m_disTick = Simulator::Schedule(std::max(Seconds(0), m_disStart - Simulator::Now()), &RplAgent::FloodDis, this);
+    }
+  }
+
+  static void OnL3Rx(RplAgent *self, Ptr<const Packet>, Ptr<Ipv6>, uint32_t) { self->m_rxCount++; }
+
+  void CheckLoad() {
+    bool was = m_saturated;
+    if (m_saturationPps > 0.0) {
+      if (!m_saturated && m_rxCount > m_saturationPps) m_saturated = true;
+      else if (m_saturated && m_rxCount < 0.5 * m_saturationPps) m_saturated = false;
+    }
+    if (m_metrics) m_metrics->NoteRootLoad(GetNode()->GetId(), m_rxCount, m_saturated, m_saturated && !was);
+    m_rxCount = 0;
+    if (m_saturated != was) {
+      m_rank = kRootRank + (m_saturated ? m_loadPenalty : 0);
+      ResetTrickle();
+    }
+    m_loadCheck = Simulator::Schedule(Seconds(1), &RplAgent::CheckLoad, this);
+  }
+
+  void StopApplication() override {
+    Simulator::Cancel(m_trickleSend);
+    Simulator::Cancel(m_trickleEnd);
+    Simulator::Cancel(m_loadCheck);
+    Simulator::Cancel(m_daoTimer);
+    Simulator::Cancel(m_daoSoon);
+    Simulator::Cancel(m_daoFlush);
+    Simulator::Cancel(m_attackTick);
+    Simulator::Cancel(m_disTick);
+    if (m_rx) m_rx->Close();
+    for (Ptr<Socket> s : m_tx) s->Close();
+    if (m_mop != kMopNone) NoteTable();
+    if (m_metrics && !m_isRoot) {
+      m_metrics->NoteRouting(GetNode()->GetId(), (m_parent ? static_cast<int32_t>(m_parent) - 1 : -1),
+                             m_rank, m_switches, static_cast<uint32_t>(m_nbrs.size()), m_dodag);
+    }
+  }
+
+  // ---- trickle (RFC 6206) ----
+  void ResetTrickle() {
+    m_interval = m_imin;
+    StartInterval();
+  }
+  void StartInterval() {
+    Simulator::Cancel(m_trickleSend);
+    Simulator::Cancel(m_trickleEnd);
+    m_heard = 0;
+    Time t = m_interval * m_rand->GetValue(0.5, 1.0);
+    m_trickleSend = Simulator::Schedule(t, &RplAgent::TrickleFire, this);
+    m_trickleEnd = Simulator::Schedule(m_interval, &RplAgent::TrickleExpire, this);
+  }
+  void TrickleFire() { if (m_heard < m_k) SendDio(); }
+  void TrickleExpire() {
+    Time imax = m_imin * static_cast<double>(1u << m_doublings);
+    m_interval = std::min(m_interval * 2, imax);
+    StartInterval();
+  }
+
+  void SendDio() {
+    if (m_rank == kInfiniteRank && !m_isRoot) return;
+    for (uint32_t i = 0; i < m_tx.size(); ++i) {
+      RplHdr h{};
+      h.type = kRplDio; h.version = m_version; h.rank = m_rank; h.lladdr = m_self;
+      if (m_attacking && m_dioAttack == kDioAttackVersion) h.version = static_cast<uint8_t>(m_version + 1);
+      if (m_attacking && m_dioAttack == kDioAttackRank) h.rank = kRootRank + 1;
+      Ipv6Address dodag = m_isRoot ? GlobalAddress(m_txIf[i]) : m_dodag;
+      dodag.Serialize(h.dodag);
+      GlobalAddress(m_txIf[i]).Serialize(h.origin);
+      Send(m_tx[i], h, Inet6SocketAddress(Ipv6Address::GetAllNodesMulticast(), m_port));
+    }
+  }
+
+  void FloodDis() {
+    RplHdr h{};
+    h.type = kRplDis; h.version = m_version; h.rank = kInfiniteRank; h.lladdr = m_self;
+    for (Ptr<Socket> s : m_tx) Send(s, h, Inet6SocketAddress(Ipv6Address::GetAllNodesMulticast(), m_port));
+    m_disTick = Simulator::Schedule(Seconds(1.0 / m_disPps), &RplAgent::FloodDis, this);
+  }
+
+  // Multicast DIS (RFC 6550 8.3): reset trickle unless already at Imin.
+  void HandleDis(const RplHdr &h) {
+    if (h.lladdr == m_self || (m_rank == kInfiniteRank && !m_isRoot)) return;
+    bool limited = m_disLimitPps > 0.0 && !TakeDisToken(h.lladdr);
+    bool reset = !limited && m_interval > m_imin;
+    if (reset) ResetTrickle();
+    if (m_metrics) m_metrics->NoteDisRx(limited, reset);
+  }
+
+  bool TakeDisToken(uint16_t sender) {
+    Time now = Simulator::Now();
+    uint16_t key = (m_disBuckets.count(sender) || m_disBuckets.size() < kMaxDisBuckets) ? sender : 0;
+    DisBucket &b = m_disBuckets.emplace(key, DisBucket{2.0, now}).first->second;
+    b.tokens = std::min(2.0, b.tokens + (now - b.last).GetSeconds() * m_disLimitPps);
+    b.last = now;
+    if (b.tokens < 1.0) return false;
+    b.tokens -= 1.0;
+    return true;
+  }
+
+  // Forged DIOs go out every period regardless of trickle suppression.
+  void AttackTick() {
+    if (!m_attacking && m_dioAttack == kDioAttackRank) {
+      for (uint32_t i : m_txIf) m_ipv6->SetForwarding(i, false);
+    }
+    m_attacking = true;
+    SendDio();
+    m_attackTick = Simulator::Schedule(m_attackPeriod, &RplAgent::AttackTick, this);
+  }
+
+  void Send(Ptr<Socket> s, const RplHdr &h, const Inet6SocketAddress &to) {
+    Ptr<Packet> p = Create<Packet>(reinterpret_cast<const uint8_t*>(&h), sizeof(h));
+    if (g_llsec) g_llsec->Pad(p);
+    if (s->SendTo(p, 0, to) >= 0 && m_metrics) m_metrics->NoteRplTx(h.type, p->GetSize());
+  }
+
+  Ipv6Address GlobalAddress(uint32_t ifIndex) const {
+    for (uint32_t a = 0; a < m_ipv6->GetNAddresses(ifIndex); ++a) {
+      Ipv6Address addr = m_ipv6->GetAddress(ifIndex, a).GetAddress();
+      if (!addr.IsLinkLocal()) return addr;
+    }
+    return Ipv6Address::GetAny();
+  }
+
+  void HandleRead(Ptr<Socket> s) {
+    Address from;
+    Ptr<Packet> p;
+    while ((p = s->RecvFrom(from))) {
+      if (!Inet6SocketAddress::IsMatchingType(from)) continue;
+      uint8_t type = 0xff;
+      p->CopyData(&type, 1);
+      if (type == kRplDao) { HandleDao(p, Inet6SocketAddress::ConvertFrom(from).GetIpv6()); continue; }
+      if (p->GetSize() < sizeof(RplHdr)) continue;
+      RplHdr h;
+      p->CopyData(reinterpret_cast<uint8_t*>(&h), sizeof(h));
+      if (h.type == kRplDio) HandleDio(h, Inet6SocketAddress::ConvertFrom(from).GetIpv6());
+      else if (h.type == kRplDis) HandleDis(h);
+    }
+  }
+
+  void HandleDio(const RplHdr &h, const Ipv6Address &ll) {
+    if (h.lladdr == m_self) return;
+    Neighbour &n = m_nbrs[h.lladdr];
+    n.ll = ll;
+    n.global = Ipv6Address::Deserialize(h.origin);
+    n.dodag = Ipv6Address::Deserialize(h.dodag);
+    n.rank = h.rank;
+    n.version = h.version;
+    n.lastHeard = Simulator::Now();
+    if (m_isRoot) {
+      // Only the root may move its DODAG on; a newer version heard for it
+      // is answered by moving past it, which is itself a global repair.
+      if (m_ipv6->GetInterfaceForAddress(n.dodag) >= 0 && Newer(h.version, m_version)) {
+        m_version = static_cast<uint8_t>(h.version + 1);
+        if (m_metrics) m_metrics->NoteRepair(true);
+        ResetTrickle();
+      }
+      return;
+    }
+    if (m_parent && n.dodag == m_dodag && Newer(h.version, m_version)) {
+      m_version = h.version;
+      m_rank = kInfiniteRank;
+      if (m_metrics) m_metrics->NoteRepair(false);
+    }
+    if (h.rank != kInfiniteRank && m_rank != kInfiniteRank && h.rank + kParentSwitchThreshold >= m_rank) m_heard++;
+    SelectParent();
+  }
+
+  // Version comparison with 8-bit wrap-around.
+  static bool Newer(uint8_t a, uint8_t b) { return static_cast<int8_t>(a - b) > 0; }
+
+  // During a global repair only neighbours already on our version qualify.
+  bool Eligible(const Neighbour &n) const { return !m_parent || !(n.dodag == m_dodag) || n.version == m_version; }
+
+  // ---- MRHOF ----
+  uint32_t PathCost(const Neighbour &n) const {
+    if (n.rank == kInfiniteRank || n.etx > kMaxLinkEtx) return kInfiniteRank;
+    return std::min<uint32_t>(kInfiniteRank, n.rank + n.etx);
+  }
+
+  void SelectParent() {
+    uint16_t best = 0;
+    uint32_t bestCost = kInfiniteRank;
+    for (const auto &kv : m_nbrs) {
+      const Neighbour &n = kv.second;
+      // Parents must advertise a lower rank than ours (loop avoidance),
+      // except the current parent whose cost we always re-evaluate.
+      if (kv.first != m_parent && m_rank != kInfiniteRank && n.rank >= m_rank) continue;
+      if (!Eligible(n)) continue;
+      uint32_t c = PathCost(n);
+      if (c < bestCost) { bestCost = c; best = kv.first; }
+    }
+    uint32_t curCost = (m_parent && Eligible(m_nbrs[m_parent])) ? PathCost(m_nbrs[m_parent])
+                                                                : static_cast<uint32_t>(kInfiniteRank);
+    if (best && best != m_parent && (curCost == kInfiniteRank || bestCost + kParentSwitchThreshold < curCost)) {
+      SwitchParent(best);
+      curCost = bestCost;
+    } else if (!best && m_parent && curCost == kInfiniteRank) {
+      SwitchParent(0);
+    }
+    uint16_t newRank = static_cast<uint16_t>(curCost);
+    if (newRank != m_rank) m_rank = newRank;
+  }
+
+  void SwitchParent(uint16_t to) {
+    Ptr<Ipv6StaticRouting> sr = Ipv6StaticRoutingHelper().GetStaticRouting(m_ipv6);
+    if (m_parent) {
+      sr->RemoveRoute(m_dodag, Ipv6Prefix(128), 1, Ipv6Address("::"));
+      if (m_hasUp) sr->RemoveRoute(m_upPrefix, m_upLen, 1, Ipv6Address("::"));
+    }
+    bool first = (m_parent == 0);
+    m_parent = to;
+    if (to) {
+      const Neighbour &n = m_nbrs[to];
+      m_dodag = n.dodag;
+      m_version = n.version;
+      sr->AddHostRouteTo(m_dodag, n.ll, 1);
+      if (m_hasUp) sr->AddNetworkRouteTo(m_upPrefix, m_upLen, n.ll, 1);
+      if (!first) m_switches++;
+      if (m_mop != kMopNone) {
+        Simulator::Cancel(m_daoSoon);
+        m_daoSoon = Simulator::Schedule(Seconds(m_rand->GetValue(0.5, 1.5)), &RplAgent::SendDao, this);
+      }
+    }
+    if (g_mobility) g_mobility->OnParentChange(GetNode()->GetId(), to ? static_cast<int32_t>(to) - 1 : -1);
+    ResetTrickle();
+  }
+
+  // ---- DAOs and downward routes ----
+  uint16_t DaoLifetime() const { return static_cast<uint16_t>(std::min(65535.0, 3 * m_daoPeriod.GetSeconds())); }
+
+  void DaoTick() {
+    ExpireRoutes();
+    SendDao();
+    m_daoTimer = Simulator::Schedule(m_daoPeriod, &RplAgent::DaoTick, this);
+  }
+
+  // Own target, plus (storing) every target of the sub-DODAG.
+  void SendDao() {
+    if (m_isRoot || !m_parent || m_tx.empty()) return;
+    const Neighbour &par = m_nbrs[m_parent];
+    Ipv6Address self = GlobalAddress(m_txIf[0]);
+    if (m_mop == kMopNonStoring) {
+      SendDaoTo({{self, par.global}}, Inet6SocketAddress(m_dodag, m_ctrlPort));
+      return;
+    }
+    QueueDao(self);
+    for (const auto &kv : m_routes) QueueDao(kv.first);
+  }
+
+  void QueueDao(const Ipv6Address &target) {
+    if (!m_daoAgg.IsStrictlyPositive()) {
+      SendDaoTo({{target, GlobalAddress(m_txIf[0])}}, ParentDaoAddress());
+      return;
+    }
+    m_daoQueue.insert(target);
+    if (!m_daoFlush.IsPending()) m_daoFlush = Simulator::Schedule(m_daoAgg, &RplAgent::FlushDao, this);
+  }
+
+  void FlushDao() {
+    if (m_parent) {
+      Ipv6Address self = GlobalAddress(m_txIf[0]);
+      std::vector<std::pair<Ipv6Address, Ipv6Address>> batch;
+      for (const Ipv6Address &t : m_daoQueue) {
+        batch.push_back({t, self});
+        if (batch.size() == kMaxDaoTargets) { SendDaoTo(batch, ParentDaoAddress()); batch.clear(); }
+      }
+      if (!batch.empty()) SendDaoTo(batch, ParentDaoAddress());
+    }
+    m_daoQueue.clear();
+  }
+
+  // Roots take DAOs through the Mitigator port, other parents on the RPL port.
+  Inet6SocketAddress ParentDaoAddress() {
+    const Neighbour &par = m_nbrs[m_parent];
+    return Inet6SocketAddress(par.ll, par.global == par.dodag ? m_ctrlPort : m_port);
+  }
+
+  void SendDaoTo(const std::vector<std::pair<Ipv6Address, Ipv6Address>> &targets, const Inet6SocketAddress &to) {
+    Ptr<Packet> p = MakeDao(m_daoSeq++, DaoLifetime(), targets);
+    if (g_llsec) g_llsec->Pad(p);
+    if (m_tx[0]->SendTo(p, 0, to) >= 0 && m_metrics) {
+      m_metrics->NoteRplTx(kRplDao, p->GetSize());
+      m_metrics->NoteDaoTx(static_cast<uint32_t>(targets.size()), sizeof(RplDao) + kUdpIpv6HeaderBytes);
+    }
+  }
+
+  void HandleDao(Ptr<Packet> p, const Ipv6Address &from) {
+    RplDao h;
+    if (m_mop == kMopNone || p->GetSize() < sizeof(h)) return;
+    std::vector<uint8_t> buf(p->GetSize());
+    p->CopyData(buf.data(), buf.size());
+    std::memcpy(&h, buf.data(), sizeof(h));
+    if (h.type != kRplDao || h.nTargets == 0 || buf.size() < sizeof(h) + h.nTargets * sizeof(RplDaoTarget)) return;
+    Time expires = Simulator::Now() + Seconds(h.lifetime);
+    for (uint32_t k = 0; k < h.nTargets; ++k) {
+      RplDaoTarget t;
+      std::memcpy(&t, buf.data() + sizeof(h) + k * sizeof(t), sizeof(t));
+      Ipv6Address target = Ipv6Address::Deserialize(t.target);
+      if (m_ipv6->GetInterfaceForAddress(target) >= 0) continue;
+      if (m_mop == kMopStoring) StoreRoute(target, from, expires);
+      else if (m_isRoot) StoreTransit(target, Ipv6Address::Deserialize(t.parent), expires);
+      if (m_isRoot && !m_onTarget.IsNull()) m_onTarget(target);
+    }
+    NoteTable();
+  }
+
+  uint32_t IfFor(const Ipv6Address &target) const {
+    int32_t i = m_ipv6->GetInterfaceForPrefix(target, Ipv6Prefix(64));
+    return (i > 0) ? static_cast<uint32_t>(i) : 1;
+  }
+
+  // Storing mode: host route to target via the child the DAO came from;
+  // a newly learned target is passed up straight away.
+  void StoreRoute(const Ipv6Address &target, const Ipv6Address &child, Time expires) {
+    Ptr<Ipv6StaticRouting> sr = Ipv6StaticRoutingHelper().GetStaticRouting(m_ipv6);
+    Ipv6Address via = child.IsLinkLocal() ? child : LinkLocalOf(child);
+    auto it = m_routes.find(target);
+    bool fresh = (it == m_routes.end());
+    if (!fresh && it->second.via != via) sr->RemoveRoute(target, Ipv6Prefix(128), it->second.ifIndex, Ipv6Address("::"));
+    if (fresh || it->second.via != via) sr->AddHostRouteTo(target, via, IfFor(target));
+    m_routes[target] = {via, IfFor(target), expires};
+    if (fresh && !m_isRoot && m_parent) QueueDao(target);
+  }
+
+  // Non-storing root: remember the transit parent; a parent change moves
+  // the paths of the target's sub-DODAG, so those targets are re-plumbed.
+  void StoreTransit(const Ipv6Address &target, const Ipv6Address &parent, Time expires) {
+    const CompactRouteTable::Entry *old = m_transit.Find(target);
+    bool moved = old && m_transit.Parent(*old) != parent;
+    m_transit.Insert(target, parent, expires);
+    Plumb(target);
+    if (!moved) return;
+    auto it = m_routedVia.find(target);
+    if (it == m_routedVia.end()) return;
+    std::set<Ipv6Address> below = it->second;
+    for (const Ipv6Address &t : below) Plumb(t);
+  }
+
+  // Walk transit parents from target up to this root. path is filled in
+  // forwarding order (root's child first, target last); returns the number
+  // of table lookups, or 0 if the chain is broken or loops.
+  uint32_t SourceRoute(const Ipv6Address &target, std::vector<Ipv6Address> &path) const {
+    path.assign(1, target);
+    uint32_t lookups = 0;
+    Ipv6Address cur = target;
+    while (true) {
+      lookups++;
+      const CompactRouteTable::Entry *e = m_transit.Find(cur);
+      if (!e || path.size() > kMaxSourceRoute) return 0;
+      cur = m_transit.Parent(*e);
+      if (m_ipv6->GetInterfaceForAddress(cur) >= 0) break;
+      path.push_back(cur);
+    }
+    std::reverse(path.begin(), path.end());
+    return lookups;
+  }
+
+  // ns-3 cannot carry an RFC 6554 source routing header, so the path the
+  // root would write into it is installed as per-hop host routes instead.
+  // This is simulation plumbing; only the root table counts as route state.
+  void Plumb(const Ipv6Address &target) {
+    Unplumb(target);
+    Plumbing &plumbed = m_plumbed[target];
+    std::vector<Ipv6Address> path;
+    if (!SourceRoute(target, path)) return;
+    Ipv6StaticRoutingHelper().GetStaticRouting(m_ipv6)->AddHostRouteTo(target, LinkLocalOf(path[0]), IfFor(target));
+    plumbed.hops.push_back({m_ipv6, IfFor(target)});
+    plumbed.via.assign(path.begin(), path.end() - 1);
+    for (const Ipv6Address &v : plumbed.via) m_routedVia[v].insert(target);
+    for (size_t k = 0; k + 1 < path.size(); ++k) {
+      Ptr<Ipv6> ip;
+      uint32_t ifIndex;
+      if (!FindInterface(path[k], ip, ifIndex)) break;
+      Ipv6StaticRoutingHelper().GetStaticRouting(ip)->AddHostRouteTo(target, LinkLocalOf(path[k + 1]), ifIndex);
+      plumbed.hops.push_back({ip, ifIndex});
+    }
+  }
+
+  void Unplumb(const Ipv6Address &target) {
+    auto it = m_plumbed.find(target);
+    if (it == m_plumbed.end()) return;
+    for (const auto &hop : it->second.hops) {
+      Ipv6StaticRoutingHelper().GetStaticRouting(hop.first)->RemoveRoute(target, Ipv6Prefix(128), hop.second, Ipv6Address("::"));
+    }
+    for (const Ipv6Address &v : it->second.via) {
+      auto through = m_routedVia.find(v);
+      if (through == m_routedVia.end()) continue;
+      through->second.erase(target);
+      if (through->second.empty()) m_routedVia.erase(through);
+    }
+    m_plumbed.erase(it);
+  }
+
+  void ExpireRoutes() {
+    Time now = Simulator::Now();
+    bool changed = false;
+    Ptr<Ipv6StaticRouting> sr = Ipv6StaticRoutingHelper().GetStaticRouting(m_ipv6);
+    for (auto it = m_routes.begin(); it != m_routes.end();) {
+      if (it->second.expires > now) { ++it; continue; }
+      sr->RemoveRoute(it->first, Ipv6Prefix(128), it->second.ifIndex, Ipv6Address("::"));
+      it = m_routes.erase(it);
+      changed = true;
+    }
+    for (const Ipv6Address &target : m_transit.Expire(now)) {
+      Unplumb(target);
+      changed = true;
+    }
+    if (changed) NoteTable();
+  }
+
+  void NoteTable() {
+    if (!m_metrics) return;
+    if (m_mop == kMopStoring) m_metrics->NoteRouteTable(GetNode()->GetId(), m_routes.size(), m_routes.size() * kStoringEntryBytes);
+    else if (m_isRoot) m_metrics->NoteRouteTable(GetNode()->GetId(), m_transit.Size(), m_transit.Bytes());
+  }
+
+  // Non-storing root: the source route each downward packet would carry.
+  static void OnL3Tx(RplAgent *self, Ptr<const Packet> p, Ptr<Ipv6>, uint32_t) {
+    Ipv6Header ip;
+    if (!self->m_metrics || p->PeekHeader(ip) == 0 || !self->m_transit.Find(ip.GetDestination())) return;
+    std::vector<Ipv6Address> path;
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t lookups = self->SourceRoute(ip.GetDestination(), path);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    if (lookups) self->m_metrics->NoteSourceRoute(static_cast<uint32_t>(path.size()), SrhBytes(path), lookups, ns);
+  }
+
+  // ---- ETX from MAC ACK outcomes (EWMA, alpha = 0.9) ----
+  static uint16_t DestShort(Ptr<const Packet> p) {
+    LrWpanMacHeader hdr;
+    p->PeekHeader(hdr);
+    if (!hdr.IsData() || hdr.GetDstAddrMode() != LrWpanMacHeader::SHORTADDR) return 0;
+    uint8_t b[2]; hdr.GetShortDstAddr().CopyTo(b);
+    uint16_t a = static_cast<uint16_t>((b[0] << 8) | b[1]);
+    return (a == 0xffff) ? 0 : a;
+  }
+  static void OnMacTx(RplAgent *self, Ptr<const Packet> p) {
+    uint16_t d = DestShort(p);
+    auto it = self->m_nbrs.find(d);
+    if (d && it != self->m_nbrs.end()) it->second.attempts++;
+  }
+  static void OnMacTxOk(RplAgent *self, Ptr<const Packet> p) { self->UpdateEtx(DestShort(p), true); }
+  static void OnMacTxDrop(RplAgent *self, Ptr<const Packet> p) { self->UpdateEtx(DestShort(p), false); }
+
+  void UpdateEtx(uint16_t d, bool acked) {
+    auto it = m_nbrs.find(d);
+    if (!d || it == m_nbrs.end()) return;
+    Neighbour &n = it->second;
+    uint32_t sample = acked ? std::max(1u, n.attempts) : 10;   // no-ACK penalty
+    n.etx = static_cast<uint16_t>((n.etx * 90 + sample * 128 * 10) / 100);
+    n.attempts = 0;
+    if (!m_isRoot) SelectParent();
+  }
+
+  Ptr<Ipv6> m_ipv6;
+  Ptr<Socket> m_rx;
+  std::vector<Ptr<Socket>> m_tx;
+  std::vector<uint32_t> m_txIf;   // 6LoWPAN interface index per tx socket
+  uint16_t m_port{61617};
+  bool m_isRoot{false};
+  uint16_t m_self{0};
+
+  std::map<uint16_t, Neighbour> m_nbrs;
+  uint16_t m_parent{0};
+  uint16_t m_rank{kInfiniteRank};
+  uint8_t m_version{0};
+  Ipv6Address m_dodag;
+  uint32_t m_switches{0};
+  bool m_hasUp{false};
+  Ipv6Address m_upPrefix;
+  Ipv6Prefix m_upLen;
+
+  uint8_t m_mop{kMopNone};
+  Time m_daoPeriod{Seconds(15)};
+  uint16_t m_ctrlPort{61616};
+  uint8_t m_daoSeq{0};
+  EventId m_daoTimer;
+  EventId m_daoSoon;
+  Time m_daoAgg{Seconds(0)};
+  std::set<Ipv6Address> m_daoQueue;
+  EventId m_daoFlush;
+  Callback<void, Ipv6Address> m_onTarget;
+
+  uint8_t m_dioAttack{kDioAttackNone};
+  Time m_attackStart{Seconds(12)};
+  Time m_attackPeriod{Seconds(5)};
+  bool m_attacking{false};
+  EventId m_attackTick;
+  double m_disPps{0.0};
+  Time m_disStart{Seconds(12)};
+  EventId m_disTick;
+  double m_disLimitPps{0.0};
+  std::map<uint16_t, DisBucket> m_disBuckets;   // key 0: overflow bucket
+  std::map<Ipv6Address, StoredRoute> m_routes;   // storing mode, every node
+  CompactRouteTable m_transit;                    // non-storing mode, root only
+  std::map<Ipv6Address, Plumbing> m_plumbed;
+  std::map<Ipv6Address, std::set<Ipv6Address>> m_routedVia;   // transit node -> targets routed through it
+
+  Time m_imin{Seconds(1)};
+  uint32_t m_doublings{8};
+  uint32_t m_k{10};
+  Time m_interval{Seconds(1)};
+  uint32_t m_heard{0};
+  EventId m_trickleSend;
+  EventId m_trickleEnd;
+
+  double m_saturationPps{0.0};
+  uint16_t m_loadPenalty{1024};
+  uint64_t m_rxCount{0};
+  bool m_saturated{false};
+  EventId m_loadCheck;
+  Ptr<UniformRandomVariable> m_rand{CreateObject<UniformRandomVariable>()};
+  MetricsCollector *m_metrics{nullptr};
+};
+
+// ---------------- Backhaul ----------------
+// Roots reach a local server over a wired backhaul carved out of
+// 2001:db8:ff::/48: one shared /64 for CSMA, one /64 per root for p2p.
+static const Ipv6Address kBackhaulNet("2001:db8:ff::");
+static const Ipv6Prefix kBackhaulLen(48);
+
+static Ipv6Address BackhaulPrefix(uint32_t link) {
+  std::ostringstream os;
+  os << "2001:db8:ff:" << std::hex << link << "::";
+  return Ipv6Address(os.str().c_str());
+}
+
+// Border router forwarding counters; the forward trace passes the egress interface.
+static void BorderForward(MetricsCollector *m, uint32_t root, uint32_t bhIf,
+                          const Ipv6Header &, Ptr<const Packet>, uint32_t ifIndex) {
+  m->NoteBorderForward(root, ifIndex == bhIf);
+}
+
+static void BorderDrop(MetricsCollector *m, uint32_t root, const Ipv6Header &, Ptr<const Packet>,
+                       Ipv6L3Protocol::DropReason, Ptr<Ipv6>, uint32_t) {
+  m->NoteBorderDrop(root);
+}
+
+// Server in front of several roots: a host route per target towards the
+// root that last registered it, ahead of the per-PAN routes via root 0.
+class DownwardSteering {
+public:
+  void Setup(Ptr<Ipv6StaticRouting> sr, const std::vector<std::pair<Ipv6Address, uint32_t>> &gw) {
+    m_sr = sr; m_gw = gw;
+  }
+
+  // Target hook for the RplAgent at root r.
+  static void OnTarget(DownwardSteering *self, uint32_t r, Ipv6Address target) { self->Steer(r, target); }
+
+private:
+  void Steer(uint32_t r, const Ipv6Address &target) {
+    auto it = m_root.find(target);
+    if (it != m_root.end() && it->second == r) return;
+    if (it != m_root.end()) m_sr->RemoveRoute(target, Ipv6Prefix(128), m_gw[it->second].second, Ipv6Address("::"));
+    m_sr->AddHostRouteTo(target, m_gw[r].first, m_gw[r].second);
+    m_root[target] = r;
+  }
+
+  Ptr<Ipv6StaticRouting> m_sr;
+  std::vector<std::pair<Ipv6Address, uint32_t>> m_gw;   // per root: address, server interface
+  std::map<Ipv6Address, uint32_t> m_root;
+};
+
+#ifdef NS3_MPI
+// Folds every rank's metrics shard into rank 0's collector.
+static void GatherShards(MetricsCollector &metrics) {
+  MPI_Comm comm = MpiInterface::GetCommunicator();
+  int rank = 0, size = 1;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  std::vector<uint8_t> mine = metrics.Pack();
+  int n = static_cast<int>(mine.size());
+  std::vector<int> sizes(size, 0), offsets(size, 0);
+  MPI_Gather(&n, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, comm);
+  std::vector<uint8_t> all;
+  if (rank == 0) {
+    for (int k = 1; k < size; ++k) offsets[k] = offsets[k - 1] + sizes[k - 1];
+    all.resize(offsets[size - 1] + sizes[size - 1]);
+  }
+  MPI_Gatherv(mine.data(), n, MPI_BYTE, all.data(), sizes.data(), offsets.data(), MPI_BYTE, 0, comm);
+  if (rank != 0) return;
+  for (int k = 1; k < size; ++k) {
+    MetricsCollector shard;
+    shard.Unpack(std::vector<uint8_t>(all.begin() + offsets[k], all.begin() + offsets[k] + sizes[k]));
+    metrics.Merge(shard);
+  }
+}
+#endif
+
+// ---------------- main ----------------
+int main(int argc, char *argv[]) {
   srand(time(nullptr));
   
   // defaults
@@ -299,6 +2852,66 @@ int main(int argc, char *argv[]) {
   double windowSec = 1.0;
   double attackerPps = 600.0;
   uint32_t attackerPkt = 120;
+  bool capture = false;
+  double capturePreSec = 0.5;
+  double capturePostSec = 0.5;
+  uint32_t captureNodeKB = 16;
+  uint32_t captureMaxKB = 4096;
+  double capturePdr = 0.8;
+  bool flowMon = false;
+  bool confirmable = false;
+  double ackTimeoutSec = 2.0;
+  uint32_t maxRetransmit = 4;
+  std::string churn = "";
+  double stateTtlSec = 0.0;
+  double mobileFraction = 0.0;
+  double mobileSpeed = 1.5;
+  uint32_t vehicleNodes = 0;
+  double vehicleSpeed = 8.0;
+  bool mobileAttacker = false;
+  double radioRange = 30.0;
+  std::string propagation = "default";
+  double plExponent = 3.0;
+  double shadowSigmaDb = 4.0;
+  std::string fading = "none";
+  double nakagamiM = 1.0;
+  uint32_t interferers = 0;
+  double interfererDbm = 0.0;
+  double interfererDuty = 0.1;
+  double interfererPeriodMs = 50.0;
+  bool linkStats = false;
+  uint32_t channels = 1;
+  std::string channelAssign = "rows";
+  bool rpl = false;
+  uint32_t roots = 1;
+  double rootSaturationPps = 0.0;
+  uint32_t rootLoadPenalty = 1024;
+  double dioIminSec = 1.0;
+  uint32_t dioDoublings = 8;
+  uint32_t dioK = 10;
+  std::string backhaul = "none";
+  double backhaulMbps = 100.0;
+  double backhaulDelayMs = 1.0;
+  std::string mop = "none";
+  double daoPeriodSec = 15.0;
+  bool attackDao = false;
+  std::string routeBench = "";
+  double daoAggDelayMs = 0.0;
+  std::string dioAttack = "none";
+  double dioAttackPeriodSec = 5.0;
+  double disFloodPps = 0.0;
+  double disRateLimit = 0.0;
+  bool allowlist = false;
+  uint32_t allowSampleEvery = 20;
+  bool insiderAttacker = false;
+  bool savi = false;
+  uint32_t attackRotate = 0;
+  std::string llsec = "none";
+  bool localize = false;
+  bool partitioned = false;
+  bool nullMessage = false;
+  double llsecCpuUs = 200.0;
+  double llsecCpuMw = 3.0;
 
   CommandLine cmd;
   cmd.AddValue("nNodes", "Total nodes (root + leaves)", nNodes);
@@ -310,62 +2923,451 @@ int main(int argc, char *argv[]) {
   cmd.AddValue("windowSec", "Mitigator window in seconds", windowSec);
   cmd.AddValue("attackerPps", "Attacker packets per second", attackerPps);
   cmd.AddValue("attackerPkt", "Attacker packet payload bytes", attackerPkt);
+  cmd.AddValue("capture", "Triggered pcap capture around security events", capture);
+  cmd.AddValue("capturePreSec", "Capture window before a trigger (s)", capturePreSec);
+  cmd.AddValue("capturePostSec", "Capture window after a trigger (s)", capturePostSec);
+  cmd.AddValue("captureNodeKB", "Per-node rolling capture buffer (KiB)", captureNodeKB);
+  cmd.AddValue("captureMaxKB", "Total pcap bytes written per run (KiB)", captureMaxKB);
+  cmd.AddValue("capturePdr", "Interval PDR below which a capture is triggered", capturePdr);
+  cmd.AddValue("flowMon", "Write IP-layer per-flow statistics", flowMon);
+  cmd.AddValue("confirmable", "Send downward traffic as confirmable (ACKed) messages", confirmable);
+  cmd.AddValue("ackTimeoutSec", "Confirmable initial ACK timeout (s)", ackTimeoutSec);
+  cmd.AddValue("maxRetransmit", "Confirmable retransmissions before giving up", maxRetransmit);
+  cmd.AddValue("churn", "Node failures node:down:up[:readdr],... (times in s)", churn);
+  cmd.AddValue("stateTtlSec", "Mitigator idle-source state TTL (0 = keep forever)", stateTtlSec);
+  cmd.AddValue("mobileFraction", "Fraction of leaves using random waypoint mobility", mobileFraction);
+  cmd.AddValue("mobileSpeed", "Max random-waypoint / mobile attacker speed (m/s)", mobileSpeed);
+  cmd.AddValue("vehicleNodes", "Leaves shuttling along road-like paths", vehicleNodes);
+  cmd.AddValue("vehicleSpeed", "Vehicle path speed (m/s)", vehicleSpeed);
+  cmd.AddValue("mobileAttacker", "Attacker sweeps through the network", mobileAttacker);
+  cmd.AddValue("radioRange", "Range used to derive parents for mobility metrics and cap localization (m)", radioRange);
+  cmd.AddValue("propagation", "Path loss: default|logdistance|shadowing|indoor", propagation);
+  cmd.AddValue("plExponent", "Log-distance path loss exponent", plExponent);
+  cmd.AddValue("shadowSigmaDb", "Per-link shadowing standard deviation (dB)", shadowSigmaDb);
+  cmd.AddValue("fading", "Per-packet fading: none|rayleigh|nakagami", fading);
+  cmd.AddValue("nakagamiM", "Nakagami m parameter", nakagamiM);
+  cmd.AddValue("interferers", "Number of background waveform interferers (spread over the PAN channels)", interferers);
+  cmd.AddValue("interfererDbm", "Interferer transmit power (dBm)", interfererDbm);
+  cmd.AddValue("interfererDuty", "Interferer duty cycle (0..1)", interfererDuty);
+  cmd.AddValue("interfererPeriodMs", "Interferer on/off period (ms)", interfererPeriodMs);
+  cmd.AddValue("linkStats", "Write per-link PRR statistics", linkStats);
+  cmd.AddValue("channels", "Number of 802.15.4 channels / PANs (root joins all)", channels);
+  cmd.AddValue("channelAssign", "Leaf to channel assignment: rows|roundrobin", channelAssign);
+  cmd.AddValue("rpl", "Run the RPL-like control plane (ETX / MRHOF parents)", rpl);
+  cmd.AddValue("roots", "Number of DODAG roots (nodes 0..roots-1); without --backhaul downward data still starts at root 0", roots);
+  cmd.AddValue("rootSaturationPps", "Root input rate that triggers failover (0 = off)", rootSaturationPps);
+  cmd.AddValue("rootLoadPenalty", "Rank added by a saturated root (ETX * 128)", rootLoadPenalty);
+  cmd.AddValue("dioIminSec", "DIO trickle Imin (s)", dioIminSec);
+  cmd.AddValue("dioDoublings", "DIO trickle Imax doublings", dioDoublings);
+  cmd.AddValue("dioK", "DIO trickle redundancy constant", dioK);
+  cmd.AddValue("backhaul", "Root to server link: none|p2p|csma (sender moves to the server)", backhaul);
+  cmd.AddValue("backhaulMbps", "Backhaul data rate (Mbit/s)", backhaulMbps);
+  cmd.AddValue("backhaulDelayMs", "Backhaul propagation delay (ms)", backhaulDelayMs);
+  cmd.AddValue("mop", "Downward routes: none|storing|nonstoring (needs --rpl)", mop);
+  cmd.AddValue("daoPeriodSec", "DAO refresh period (s); routes live 3 periods", daoPeriodSec);
+  cmd.AddValue("attackDao", "Attacker floods well-formed DAOs for fresh targets", attackDao);
+  cmd.AddValue("daoAggDelayMs", "Storing mode: DAO aggregation delay at parents (0 = off)", daoAggDelayMs);
+  cmd.AddValue("dioAttack", "Attacker node DIO attack: none|version|rank (needs --rpl)", dioAttack);
+  cmd.AddValue("dioAttackPeriodSec", "Period of forged DIOs (s)", dioAttackPeriodSec);
+  cmd.AddValue("disFloodPps", "Attacker node multicast DIS rate (0 = off, needs --rpl)", disFloodPps);
+  cmd.AddValue("disRateLimit", "Per-neighbour DIS/s accepted by each node (0 = unlimited)", disRateLimit);
+  cmd.AddValue("allowlist", "Roots skip detection for provisioned node addresses", allowlist);
+  cmd.AddValue("allowSampleEvery", "Allowlisted packets per sampled detector check", allowSampleEvery);
+  cmd.AddValue("insiderAttacker", "Provision the attacker too (compromised insider)", insiderAttacker);
+  cmd.AddValue("savi", "Roots bind link-layer senders to IPv6 sources and drop spoofed control (relayed sources need --mop routes)", savi);
+  cmd.AddValue("attackRotate", "Attacker rotates over this many extra source addresses", attackRotate);
+  cmd.AddValue("localize", "Roots estimate blocked attackers' positions from forwarder SINR reports", localize);
+  cmd.AddValue("llsec", "Link-layer security cost model: none|mic32|mic64|mic128", llsec);
+  cmd.AddValue("llsecCpuUs", "AES-CCM processing per frame and side (us)", llsecCpuUs);
+  cmd.AddValue("llsecCpuMw", "MCU power while running AES-CCM (mW)", llsecCpuMw);
+  cmd.AddValue("partitioned", "Run PANs on separate MPI ranks (needs --backhaul=p2p and channels == roots)", partitioned);
+  cmd.AddValue("nullMessage", "Partitioned: null-message instead of barrier synchronization", nullMessage);
+  cmd.AddValue("routeBench", "Only benchmark the root route table at these sizes (e.g. 10000,100000)", routeBench);
   cmd.Parse(argc, argv);
 
+  if (!routeBench.empty()) {
+    RunRouteBenchmark(routeBench, "run1");
+    return 0;
+  }
+
   NS_ABORT_MSG_IF(nNodes < 2, "Need at least 2 nodes.");
+  uint32_t nRoots = std::max(1u, roots);
+  NS_ABORT_MSG_IF(nNodes < nRoots + (attack ? 2 : 1), "Need at least one node besides the roots, plus the attacker with --attack.");
+  NS_ABORT_MSG_UNLESS(backhaul == "none" || backhaul == "p2p" || backhaul == "csma", "Unknown backhaul " << backhaul);
+  NS_ABORT_MSG_UNLESS(mop == "none" || mop == "storing" || mop == "nonstoring", "Unknown mop " << mop);
+  NS_ABORT_MSG_IF(mop != "none" && !rpl, "--mop needs --rpl");
+  NS_ABORT_MSG_UNLESS(dioAttack == "none" || dioAttack == "version" || dioAttack == "rank", "Unknown dioAttack " << dioAttack);
+  NS_ABORT_MSG_IF(dioAttack != "none" && !rpl, "--dioAttack needs --rpl");
+  NS_ABORT_MSG_IF(disFloodPps > 0.0 && !rpl, "--disFloodPps needs --rpl");
+  NS_ABORT_MSG_UNLESS(llsec == "none" || llsec == "mic32" || llsec == "mic64" || llsec == "mic128", "Unknown llsec " << llsec);
+  uint8_t mopId = (mop == "storing") ? kMopStoring : (mop == "nonstoring") ? kMopNonStoring : kMopNone;
 
-  NodeContainer nodes; nodes.Create(nNodes);
+  // Partitioned runs: each PAN with its root lives on one MPI rank and the
+  // server on rank 0. Only the p2p backhaul crosses ranks, so its delay is
+  // the conservative lookahead; anything needing a global view is refused.
+  uint32_t rank = 0, nParts = 1;
+  if (partitioned) {
+    NS_ABORT_MSG_UNLESS(backhaul == "p2p", "--partitioned needs --backhaul=p2p");
+    NS_ABORT_MSG_UNLESS(std::max(1u, channels) == nRoots, "--partitioned needs one root per channel (channels == roots)");
+    NS_ABORT_MSG_IF(capture || flowMon || localize || !churn.empty() || interferers > 0,
+                    "--partitioned does not support capture, flowMon, localize, churn or interferers");
+    NS_ABORT_MSG_IF(mobileFraction > 0.0 || vehicleNodes > 0 || mobileAttacker, "--partitioned does not support mobility");
+#ifdef NS3_MPI
+    GlobalValue::Bind("SimulatorImplementationType",
+                      StringValue(nullMessage ? "ns3::NullMessageSimulatorImpl" : "ns3::DistributedSimulatorImpl"));
+    MpiInterface::Enable(&argc, &argv);
+    rank = MpiInterface::GetSystemId();
+    nParts = MpiInterface::GetSize();
+#else
+    NS_ABORT_MSG("--partitioned needs ns-3 configured with --enable-mpi");
+#endif
+  }
+  // Applications only run on the rank that owns their node.
+  auto local = [&rank](Ptr<Node> n) { return n->GetSystemId() == rank; };
 
-  // Mobility (grid)
-  MobilityHelper mob;
-  Ptr<ListPositionAllocator> pos = CreateObject<ListPositionAllocator>();
+  static LinkSecurityModel llsecModel;
+  if (llsec != "none") {
+    llsecModel.Setup(llsec, MicroSeconds(llsecCpuUs), llsecCpuMw);
+    g_llsec = &llsecModel;
+  }
+
+  // Grid width, grid slot and static PAN of every leaf (contiguous grid rows
+  // or round robin); partitioned runs need these to place nodes on ranks.
   uint32_t gridW = std::max(1u, (uint32_t)std::ceil(std::sqrt((double)nNodes)));
+  uint32_t nPans = std::max(1u, channels);
+  uint32_t nRows = (nNodes + gridW - 1) / gridW;
+  uint32_t attackerId = nNodes - 1;
+  // Extra roots take the leaf slot nearest the far corners, then the centre
+  // (never the attacker's); the leaf living there moves to the root's slot.
+  std::vector<uint32_t> slot(nNodes);
+  for (uint32_t i = 0; i < nNodes; ++i) slot[i] = i;
+  const double rootSpots[][2] = {{1.0, 1.0}, {1.0, 0.0}, {0.0, 1.0}, {0.5, 0.5}};
+  std::set<uint32_t> rootSlots;
+  for (uint32_t r = 1; r < nRoots; ++r) {
+    double gx = rootSpots[(r - 1) % 4][0] * (gridW - 1), gy = rootSpots[(r - 1) % 4][1] * (nRows - 1);
+    uint32_t best = r;
+    double bestD = std::numeric_limits<double>::max();
+    for (uint32_t s = nRoots; s < attackerId; ++s) {
+      if (rootSlots.count(s)) continue;
+      double d = std::hypot(double(s % gridW) - gx, double(s / gridW) - gy);
+      if (d < bestD) { bestD = d; best = s; }
+    }
+    if (best == r) continue;
+    rootSlots.insert(best);
+    slot[best] = r;
+    slot[r] = best;
+  }
+  std::vector<uint32_t> nodePan(nNodes, 0);
+  for (uint32_t i = nRoots; i < nNodes; ++i) {
+    nodePan[i] = (channelAssign == "roundrobin") ? (i - nRoots) % nPans : std::min(nPans - 1, (slot[i] / gridW) * nPans / nRows);
+  }
+
+  NodeContainer nodes;
+  for (uint32_t i = 0; i < nNodes; ++i) {
+    uint32_t pan = (i < nRoots) ? i : nodePan[i];
+    nodes.Add(CreateObject<Node>(partitioned ? pan % nParts : 0));
+  }
+
+  // Mobility (grid); mobile nodes start from their grid slot
   double step = (gridW > 1) ? (area / (gridW - 1)) : 0.0;
+  std::vector<Vector> grid;
   for (uint32_t i = 0; i < nNodes; ++i) {
-    uint32_t x = i % gridW, y = i / gridW;
-    pos->Add(Vector(5.0 + x * step, 5.0 + y * step, 0));
+    uint32_t x = slot[i] % gridW, y = slot[i] / gridW;
+    grid.push_back(Vector(5.0 + x * step, 5.0 + y * step, 0));
+  }
+  uint32_t nLeaves = nNodes - nRoots - 1;   // excludes roots and attacker slot
+  uint32_t nRwp = static_cast<uint32_t>(std::round(mobileFraction * nLeaves));
+  std::map<uint32_t, std::string> kinds;
+  for (uint32_t k = 0; k < nRwp; ++k) kinds[nRoots + (k * nLeaves) / std::max(1u, nRwp)] = "rwp";
+  for (uint32_t i = nNodes - 2, v = 0; i >= nRoots && v < vehicleNodes; --i) {
+    if (kinds.count(i)) continue;
+    kinds[i] = "vehicle"; v++;
   }
-  mob.SetPositionAllocator(pos);
-  mob.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-  mob.Install(nodes);
+  if (attack && mobileAttacker) kinds[attackerId] = "attacker";
+
+  Ptr<RandomRectanglePositionAllocator> rect = CreateObject<RandomRectanglePositionAllocator>();
+  std::ostringstream span;
+  span << "ns3::UniformRandomVariable[Min=5.0|Max=" << 5.0 + area << "]";
+  rect->SetAttribute("X", StringValue(span.str()));
+  rect->SetAttribute("Y", StringValue(span.str()));
+  std::ostringstream rwpSpeed;
+  rwpSpeed << "ns3::UniformRandomVariable[Min=0.1|Max=" << mobileSpeed << "]";
+
+  for (uint32_t i = 0; i < nNodes; ++i) {
+    Ptr<Node> n = nodes.Get(i);
+    auto it = kinds.find(i);
+    std::string kind = (it != kinds.end()) ? it->second : "static";
+    if (kind == "vehicle" || kind == "attacker") {
+      Ptr<WaypointMobilityModel> wp = CreateObject<WaypointMobilityModel>();
+      n->AggregateObject(wp);
+      std::vector<Vector> path;
+      if (kind == "vehicle") {
+        // shuttle along the node's grid row, like a vehicle on a road
+        path = {Vector(5.0, grid[i].y, 0), Vector(5.0 + area, grid[i].y, 0)};
+        AddLoopPath(wp, path, vehicleSpeed, simTime);
+      } else {
+        // serpentine sweep over every grid row
+        for (uint32_t r = 0; r * gridW < nNodes; ++r) {
+          double y = 5.0 + r * step;
+          Vector a(5.0, y, 0), b(5.0 + area, y, 0);
+          if (r % 2) std::swap(a, b);
+          path.push_back(a); path.push_back(b);
+        }
+        path.insert(path.begin(), grid[i]);
+        AddLoopPath(wp, path, mobileSpeed, simTime);
+      }
+      continue;
+    }
+    MobilityHelper mob;
+    Ptr<ListPositionAllocator> pos = CreateObject<ListPositionAllocator>();
+    pos->Add(grid[i]);
+    mob.SetPositionAllocator(pos);
+    if (kind == "rwp") {
+      mob.SetMobilityModel("ns3::RandomWaypointMobilityModel",
+                           "Speed", StringValue(rwpSpeed.str()),
+                           "Pause", StringValue("ns3::ConstantRandomVariable[Constant=2.0]"),
+                           "PositionAllocator", PointerValue(rect));
+    } else {
+      mob.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    }
+    mob.Install(n);
+  }
+
+  static MobilityTracker mobTracker;
+  bool anyMobile = !kinds.empty();
+  if (anyMobile) {
+    mobTracker.Setup(nodes, nRoots, (attack ? static_cast<int32_t>(attackerId) : -1), radioRange, Seconds(1));
+    for (const auto &kv : kinds) mobTracker.SetKind(kv.first, kv.second);
+    g_mobility = &mobTracker;
+  }
+
+  // LR-WPAN: one PAN per channel; roots have a radio on every channel
+  // (partitioned: root c only on channel c, which gets its own medium).
+  std::vector<NodeContainer> panNodes(nPans);
+  for (uint32_t c = 0; c < nPans; ++c) {
+    for (uint32_t r = 0; r < nRoots; ++r) {
+      if (!partitioned || r == c) panNodes[c].Add(nodes.Get(r));
+    }
+  }
+  for (uint32_t i = nRoots; i < nNodes; ++i) panNodes[nodePan[i]].Add(nodes.Get(i));
 
-  // LR-WPAN
   LrWpanHelper lrwpan;
-  NetDeviceContainer devs = lrwpan.Install(nodes);
+  Ptr<SpectrumChannel> channel = BuildChannel(propagation, plExponent, shadowSigmaDb, fading, nakagamiM);
+  if (channel) lrwpan.SetChannel(channel);
+  NetDeviceContainer devs;
+  std::vector<NetDeviceContainer> panDevs(nPans);
+  for (uint32_t c = 0; c < nPans; ++c) {
+    LrWpanHelper own;   // a fresh helper brings a fresh default channel
+    if (partitioned && c > 0) {
+      Ptr<SpectrumChannel> ch = BuildChannel(propagation, plExponent, shadowSigmaDb, fading, nakagamiM);
+      if (ch) own.SetChannel(ch);
+    }
+    panDevs[c] = (partitioned && c > 0 ? own : lrwpan).Install(panNodes[c]);
+    devs.Add(panDevs[c]);
+  }
+  if (!channel) channel = DynamicCast<SpectrumChannel>(devs.Get(0)->GetChannel());
 
   const uint16_t PAN = 0xBAAD;
-  for (uint32_t i = 0; i < devs.GetN(); ++i) {
-    Ptr<LrWpanNetDevice> d = DynamicCast<LrWpanNetDevice>(devs.Get(i));
-    NS_ASSERT(d);
-    Ptr<LrWpanMac> mac = d->GetMac();
-    mac->SetPanId(PAN);
-    uint16_t shortId = static_cast<uint16_t>(i + 1);
-    uint64_t extId = 0x0000000000000001ULL + static_cast<uint64_t>(i);
-    mac->SetShortAddress(Mac16Address(shortId));
-    mac->SetExtendedAddress(Mac64Address(extId));
-  }
-
-  // 6LoWPAN
-  SixLowPanHelper sixlow;
-  NetDeviceContainer six = sixlow.Install(devs);
+  ChannelStats chStats;
+  for (uint32_t c = 0; c < nPans; ++c) {
+    for (uint32_t k = 0; k < panDevs[c].GetN(); ++k) {
+      Ptr<LrWpanNetDevice> d = DynamicCast<LrWpanNetDevice>(panDevs[c].Get(k));
+      NS_ASSERT(d);
+      uint32_t i = d->GetNode()->GetId();
+      Ptr<LrWpanMac> mac = d->GetMac();
+      mac->SetPanId(static_cast<uint16_t>(PAN + c));
+      uint16_t shortId = static_cast<uint16_t>(i + 1);
+      uint64_t extId = 0x0000000000000001ULL + static_cast<uint64_t>(i);
+      mac->SetShortAddress(Mac16Address(shortId));
+      mac->SetExtendedAddress(Mac64Address(extId));
+      if (nPans > 1) {
+        Ptr<PhyPibAttributes> pib = Create<PhyPibAttributes>();
+        pib->phyCurrentChannel = PanChannel(c);
+        d->GetPhy()->PlmeSetAttributeRequest(PhyPibAttributeIdentifier::phyCurrentChannel, pib);
+      }
+      chStats.Attach(d, c);
+    }
+  }
+
+  // Background interferers, spread round-robin over the PAN channels
+  NodeContainer jammers;
+  if (interferers > 0) {
+    jammers.Create(interferers);
+    MobilityHelper jmob;
+    Ptr<RandomRectanglePositionAllocator> jpos = CreateObject<RandomRectanglePositionAllocator>();
+    std::ostringstream jspan;
+    jspan << "ns3::UniformRandomVariable[Min=5.0|Max=" << 5.0 + area << "]";
+    jpos->SetAttribute("X", StringValue(jspan.str()));
+    jpos->SetAttribute("Y", StringValue(jspan.str()));
+    jmob.SetPositionAllocator(jpos);
+    jmob.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    jmob.Install(jammers);
+
+    LrWpanSpectrumValueHelper svh;
+    WaveformGeneratorHelper wgh;
+    wgh.SetChannel(channel);
+    wgh.SetPhyAttribute("Period", TimeValue(MilliSeconds(interfererPeriodMs)));
+    wgh.SetPhyAttribute("DutyCycle", DoubleValue(interfererDuty));
+    for (uint32_t i = 0; i < jammers.GetN(); ++i) {
+      wgh.SetTxPowerSpectralDensity(svh.CreateTxPowerSpectralDensity(interfererDbm, PanChannel(i % nPans)));
+      NetDeviceContainer wgDev = wgh.Install(jammers.Get(i));
+      Ptr<WaveformGenerator> wg =
+        DynamicCast<WaveformGenerator>(DynamicCast<NonCommunicatingNetDevice>(wgDev.Get(0))->GetPhy());
+      Simulator::Schedule(Seconds(1.0 + 0.001 * i), &WaveformGenerator::Start, wg);
+    }
+  }
+
+  LinkStats links;
+  if (linkStats) {
+    for (uint32_t i = 0; i < devs.GetN(); ++i) {
+      links.Attach(DynamicCast<LrWpanNetDevice>(devs.Get(i)), devs.Get(i)->GetNode()->GetId());
+    }
+  }
+
+  // Attack localization: every honest node reports what it overhears
+  AttackLocalizer localizer;
+  if (localize) {
+    localizer.Setup(nodes, radioRange);
+    for (uint32_t i = 0; i < devs.GetN(); ++i) {
+      uint32_t id = devs.Get(i)->GetNode()->GetId();
+      if (attack && id == attackerId) continue;
+      localizer.Attach(DynamicCast<LrWpanNetDevice>(devs.Get(i)), id);
+    }
+  }
 
-  // IPv6
+  // 6LoWPAN + IPv6, one /64 per PAN
+  SixLowPanHelper sixlow;
   InternetStackHelper internet; internet.Install(nodes);
-  Ipv6AddressHelper ipv6; ipv6.SetBase(Ipv6Address("2001:db8::"), Ipv6Prefix(64));
-  Ipv6InterfaceContainer ifs = ipv6.Assign(six);
-  for (uint32_t i = 0; i < ifs.GetN(); ++i) { 
-    ifs.SetForwarding(i, true); 
-    ifs.SetDefaultRouteInAllNodes(i); 
+  std::vector<Ipv6Address> nodeAddr(nNodes);
+  std::vector<SourceValidator> validators(nRoots);
+  for (uint32_t c = 0; c < nPans; ++c) {
+    NetDeviceContainer six = sixlow.Install(panDevs[c]);
+    if (savi) {
+      for (uint32_t k = 0; k < six.GetN(); ++k) {
+        uint32_t id = six.Get(k)->GetNode()->GetId();
+        if (id < nRoots) validators[id].Attach(nodes.Get(id), six.Get(k));
+      }
+    }
+    Ipv6AddressHelper ipv6; ipv6.SetBase(PanPrefix(c), Ipv6Prefix(64));
+    Ipv6InterfaceContainer ifs = ipv6.Assign(six);
+    for (uint32_t i = 0; i < ifs.GetN(); ++i) { 
+      ifs.SetForwarding(i, true); 
+      ifs.SetDefaultRouteInAllNodes(i); 
+      nodeAddr[panNodes[c].Get(i)->GetId()] = ifs.GetAddress(i, 1);
+    }
+  }
+  for (uint32_t r = 0; r < nRoots; ++r) nodeAddr[r] = nodes.Get(r)->GetObject<Ipv6>()->GetAddress(1, 1).GetAddress();
+  if (localize) {
+    for (uint32_t i = nRoots; i < nNodes; ++i) { localizer.Bind(nodeAddr[i], i); localizer.Bind(LinkLocalOf(nodeAddr[i]), i); }
   }
 
   // Metrics
+  // Per-rank outputs get a rank suffix; the merged metrics keep the plain prefix.
+  const std::string basePrefix = "run1";
+  const std::string runPrefix = partitioned ? basePrefix + "_p" + std::to_string(rank) : basePrefix;
   static MetricsCollector metrics;
+  metrics.SetDetectorConfig(threshold, windowSec);
+
+  // Backhaul: every root gets a wired interface towards a server node that
+  // hosts the downward sender, so the root forwards between interfaces.
+  Ptr<Node> server;
+  static DownwardSteering steering;
+  bool steer = false;
+  if (backhaul != "none") {
+    server = CreateObject<Node>();
+    internet.Install(server);
+    if (g_llsec) llsecModel.SetWiredHops(1);   // server -> root is not 802.15.4
+    Ipv6StaticRoutingHelper srh;
+    std::ostringstream rate;
+    rate << backhaulMbps << "Mbps";
+    Ipv6Address gateway;
+    uint32_t serverIf = 0;
+    std::vector<uint32_t> rootBhIf(nRoots);
+    std::vector<std::pair<Ipv6Address, uint32_t>> rootGw(nRoots);   // server side: root address, interface
+    if (backhaul == "csma") {
+      CsmaHelper csma;
+      csma.SetChannelAttribute("DataRate", StringValue(rate.str()));
+      csma.SetChannelAttribute("Delay", TimeValue(MilliSeconds(backhaulDelayMs)));
+      NodeContainer lan(server);
+      for (uint32_t r = 0; r < nRoots; ++r) lan.Add(nodes.Get(r));
+      Ipv6AddressHelper bh; bh.SetBase(BackhaulPrefix(0), Ipv6Prefix(64));
+      Ipv6InterfaceContainer ifs = bh.Assign(csma.Install(lan));
+      for (uint32_t k = 0; k < ifs.GetN(); ++k) ifs.SetForwarding(k, true);
+      serverIf = ifs.GetInterfaceIndex(0);
+      gateway = ifs.GetAddress(1, 1);
+      for (uint32_t r = 0; r < nRoots; ++r) {
+        rootBhIf[r] = ifs.GetInterfaceIndex(r + 1);
+        rootGw[r] = {ifs.GetAddress(r + 1, 1), serverIf};
+      }
+    } else {
+      PointToPointHelper p2p;
+      p2p.SetDeviceAttribute("DataRate", StringValue(rate.str()));
+      p2p.SetChannelAttribute("Delay", TimeValue(MilliSeconds(backhaulDelayMs)));
+      for (uint32_t r = 0; r < nRoots; ++r) {
+        Ipv6AddressHelper bh; bh.SetBase(BackhaulPrefix(r), Ipv6Prefix(64));
+        Ipv6InterfaceContainer ifs = bh.Assign(p2p.Install(server, nodes.Get(r)));
+        ifs.SetForwarding(0, true); ifs.SetForwarding(1, true);
+        rootBhIf[r] = ifs.GetInterfaceIndex(1);
+        rootGw[r] = {ifs.GetAddress(1, 1), ifs.GetInterfaceIndex(0)};
+        if (r == 0) { serverIf = ifs.GetInterfaceIndex(0); gateway = ifs.GetAddress(1, 1); }
+        // the server talks from its root-0 link; other roots reach it over their own
+        else srh.GetStaticRouting(nodes.Get(r)->GetObject<Ipv6>())->AddNetworkRouteTo(kBackhaulNet, kBackhaulLen, ifs.GetAddress(0, 1), rootBhIf[r]);
+      }
+    }
+    // server -> PANs via root 0, which has a radio on every channel
+    // (partitioned: via the PAN's own root)
+    Ptr<Ipv6StaticRouting> ssr = srh.GetStaticRouting(server->GetObject<Ipv6>());
+    for (uint32_t c = 0; c < nPans; ++c) {
+      if (partitioned) ssr->AddNetworkRouteTo(PanPrefix(c), Ipv6Prefix(64), rootGw[c].first, rootGw[c].second);
+      else ssr->AddNetworkRouteTo(PanPrefix(c), Ipv6Prefix(64), gateway, serverIf);
+    }
+    // several roots sharing the PANs: follow each target to its DODAG's root
+    if (!partitioned && nRoots > 1) { steering.Setup(ssr, rootGw); steer = true; }
+    // leaves -> server via root 0 (partitioned: their PAN's root) until the
+    // control plane supplies a parent
+    if (!rpl) {
+      for (uint32_t i = nRoots; i < nNodes; ++i) {
+        Ptr<Ipv6> via = nodes.Get(partitioned ? nodePan[i] : 0)->GetObject<Ipv6>();
+        Ipv6Address rootLl = via->GetAddress(partitioned ? 1 : 1 + nodePan[i], 0).GetAddress();
+        srh.GetStaticRouting(nodes.Get(i)->GetObject<Ipv6>())->AddNetworkRouteTo(kBackhaulNet, kBackhaulLen, rootLl, 1);
+      }
+    }
+    for (uint32_t r = 0; r < nRoots; ++r) {
+      Ptr<Ipv6L3Protocol> l3 = nodes.Get(r)->GetObject<Ipv6L3Protocol>();
+      l3->TraceConnectWithoutContext("UnicastForward", MakeBoundCallback(&BorderForward, &metrics, r, rootBhIf[r]));
+      l3->TraceConnectWithoutContext("Drop", MakeBoundCallback(&BorderDrop, &metrics, r));
+    }
+  }
+
+  // Source address validation: bindings from the MAC addresses set above
+  if (savi) {
+    for (SourceValidator &v : validators) {
+      v.Setup(&metrics);
+      for (uint32_t i = nRoots; i < nNodes; ++i) {
+        v.Bind(Mac16Address(static_cast<uint16_t>(i + 1)), nodeAddr[i]);
+        v.Bind(Mac64Address(0x0000000000000001ULL + static_cast<uint64_t>(i)), nodeAddr[i]);
+      }
+    }
+  }
+
+  // Triggered capture
+  static TriggeredCapture cap;
+  if (capture) {
+    cap.Setup(Seconds(capturePreSec), Seconds(capturePostSec),
+              captureNodeKB * 1024, static_cast<uint64_t>(captureMaxKB) * 1024, runPrefix);
+    for (uint32_t i = 0; i < devs.GetN(); ++i) {
+      cap.Attach(DynamicCast<LrWpanNetDevice>(devs.Get(i)), devs.Get(i)->GetNode()->GetId());
+    }
+    cap.WatchPdr(&metrics, Seconds(1), capturePdr);
+    g_capture = &cap;
+  }
 
   // Downward traffic
   uint16_t dataPort = 9000;
   std::vector<Inet6SocketAddress> dests;
-  for (uint32_t i = 1; i < nodes.GetN(); ++i) {
-    dests.push_back(Inet6SocketAddress(ifs.GetAddress(i,1), dataPort));
+  for (uint32_t i = nRoots; i < nodes.GetN(); ++i) {
+    dests.push_back(Inet6SocketAddress(nodeAddr[i], dataPort));
+    if (!local(nodes.Get(i))) continue;
     Ptr<DownSink> sink = CreateObject<DownSink>();
     sink->Setup(dataPort, &metrics);
     nodes.Get(i)->AddApplication(sink);
@@ -375,38 +3377,125 @@ int main(int argc, char *argv[]) {
 
   Ptr<DownSender> sender = CreateObject<DownSender>();
   sender->Setup(dests, rateKbps, 60, &metrics);
-  nodes.Get(0)->AddApplication(sender);
+  if (confirmable) sender->SetConfirmable(Seconds(ackTimeoutSec), maxRetransmit);
+  Ptr<Node> senderNode = server ? server : nodes.Get(0);
+  if (local(senderNode)) senderNode->AddApplication(sender);
   sender->SetStartTime(Seconds(11));
   sender->SetStopTime(Seconds(simTime - 0.5));
 
-  // Mitigator (root)
+  // Mitigator (every root)
   uint16_t ctrlPort = 61616;
-  Ptr<Mitigator> mit = CreateObject<Mitigator>();
-  mit->Setup(ctrlPort, threshold, windowSec, &metrics);
-  nodes.Get(0)->AddApplication(mit);
-  mit->SetStartTime(Seconds(5));
-  mit->SetStopTime(Seconds(simTime));
-
-  // Attacker
-  if (attack) {
+  std::vector<Ptr<Mitigator>> mits;
+  std::vector<Ipv6Address> provisioned;
+  for (uint32_t i = nRoots; i < nNodes; ++i) {
+    if (i == attackerId && !insiderAttacker) continue;
+    provisioned.push_back(nodeAddr[i]);
+    provisioned.push_back(LinkLocalOf(nodeAddr[i]));   // storing-mode DAOs come from link-local
+  }
+  for (uint32_t r = 0; r < nRoots; ++r) {
+    Ptr<Mitigator> mit = CreateObject<Mitigator>();
+    mits.push_back(mit);
+    mit->Setup(ctrlPort, threshold, windowSec, &metrics);
+    if (stateTtlSec > 0.0) mit->SetStateTtl(Seconds(stateTtlSec));
+    if (allowlist) mit->SetAllowlist(provisioned, allowSampleEvery);
+    if (localize) mit->SetBlockCallback(MakeBoundCallback(&AttackLocalizer::OnBlock, &localizer, r));
+    if (local(nodes.Get(r))) nodes.Get(r)->AddApplication(mit);
+    mit->SetStartTime(Seconds(5));
+    mit->SetStopTime(Seconds(simTime));
+  }
+
+  // Attacker: aims at the root nearest its start (partitioned: its PAN's root)
+  if (attack && local(nodes.Get(attackerId))) {
+    uint32_t pan = nodePan[attackerId], victim = partitioned ? pan : 0;
+    for (uint32_t r = 1; r < nRoots && !partitioned; ++r) {
+      if (CalculateDistance(grid[r], grid[attackerId]) < CalculateDistance(grid[victim], grid[attackerId])) victim = r;
+    }
+    Ipv6Address victimAddr = nodes.Get(victim)->GetObject<Ipv6>()->GetAddress(partitioned ? 1 : 1 + pan, 1).GetAddress();
     Ptr<SmartAttacker> atk = CreateObject<SmartAttacker>();
     atk->Setup(
-      Inet6SocketAddress(ifs.GetAddress(0,1), ctrlPort),
+      Inet6SocketAddress(victimAddr, ctrlPort),
       attackerPps,
       attackerPkt,
       12.0,
       simTime - 13.0,
       &metrics
     );
-    nodes.Get(nNodes - 1)->AddApplication(atk);
+    if (attackDao) atk->SetPayloadGenerator(MakeBoundCallback(&ForgeDao, victimAddr));
+    if (attackRotate > 0) atk->SetAddressRotation(attackRotate);
+    nodes.Get(attackerId)->AddApplication(atk);
     atk->SetStartTime(Seconds(12));
     atk->SetStopTime(Seconds(simTime - 1));
   }
 
+  // RPL-like control plane
+  uint16_t rplPort = 61617;
+  if (rpl) {
+    for (uint32_t i = 0; i < nNodes; ++i) {
+      if (!local(nodes.Get(i))) continue;
+      Ptr<RplAgent> agent = CreateObject<RplAgent>();
+      agent->Setup(rplPort, i < nRoots, Seconds(dioIminSec), dioDoublings, dioK, &metrics);
+      if (i < nRoots && rootSaturationPps > 0.0) agent->SetLoadBalancing(rootSaturationPps, static_cast<uint16_t>(rootLoadPenalty));
+      if (i >= nRoots && server) agent->SetUpwardPrefix(kBackhaulNet, kBackhaulLen);
+      if (mopId != kMopNone) {
+        agent->SetDownwardRoutes(mopId, Seconds(daoPeriodSec), ctrlPort);
+        if (mopId == kMopStoring) agent->SetDaoAggregation(MilliSeconds(daoAggDelayMs));
+        if (i < nRoots) mits[i]->SetAcceptCallback(MakeCallback(&RplAgent::ReceiveDao, agent));
+        if (i < nRoots && steer) agent->SetTargetCallback(MakeBoundCallback(&DownwardSteering::OnTarget, &steering, i));
+        if (i < nRoots && savi) validators[i].SetRelayCheck(MakeCallback(&RplAgent::RoutesVia, agent));
+      }
+      if (i == attackerId && dioAttack != "none") {
+        agent->SetDioAttack(dioAttack == "version" ? kDioAttackVersion : kDioAttackRank, Seconds(12), Seconds(dioAttackPeriodSec));
+      }
+      if (i == attackerId && disFloodPps > 0.0) agent->SetDisFlood(disFloodPps, Seconds(12));
+      if (disRateLimit > 0.0) agent->SetDisRateLimit(disRateLimit);
+      nodes.Get(i)->AddApplication(agent);
+      agent->SetStartTime(Seconds(1));
+      agent->SetStopTime(Seconds(simTime - 0.1));
+    }
+    if (g_mobility) g_mobility->UseExternalParents();
+    if (mopId != kMopNone) metrics.SetRouteMode(mop);
+    Simulator::Schedule(Seconds(12), &MetricsCollector::WatchOutage, &metrics, Seconds(1), 0.5);
+  }
+
+  // Churn
+  static ChurnController churnCtl;
+  if (!churn.empty()) {
+    churnCtl.Setup(nodes);
+    churnCtl.Schedule(ChurnController::Parse(churn));
+    g_churn = &churnCtl;
+  }
+
+  // IP-layer flow statistics
+  FlowMonitorHelper fmh;
+  Ptr<FlowMonitor> monitor;
+  if (flowMon) {
+    monitor = fmh.InstallAll();
+    monitor->SetAttribute("DelayBinWidth", DoubleValue(0.001));
+    monitor->SetAttribute("JitterBinWidth", DoubleValue(0.001));
+  }
+
   Simulator::Stop(Seconds(simTime));
   Simulator::Run();
+
+  if (flowMon) {
+    std::map<uint16_t, std::string> portClass{{dataPort, "data"}, {ctrlPort, "control"}, {rplPort, "rpl"}};
+    WriteFlowCsv(monitor, DynamicCast<Ipv6FlowClassifier>(fmh.GetClassifier6()), portClass, runPrefix);
+  }
+  if (linkStats) links.WriteCsv(runPrefix, nodes);
+  if (nPans > 1) chStats.WriteCsv(runPrefix, Seconds(simTime));
   Simulator::Destroy();
+#ifdef NS3_MPI
+  if (partitioned) {
+    GatherShards(metrics);
+    MpiInterface::Disable();
+  }
+#endif
 
-  metrics.WriteCsv("run1");
+  if (rank == 0) metrics.WriteCsv(basePrefix);
+  if (capture) cap.WriteCsv();
+  if (g_churn) churnCtl.WriteCsv(runPrefix);
+  if (anyMobile) mobTracker.WriteCsv(runPrefix);
+  if (localize) localizer.WriteCsv(runPrefix);
+  if (g_llsec) llsecModel.WriteCsv(runPrefix, Seconds(simTime));
   return 0;
 }
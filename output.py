@@ -27,20 +27,21 @@ if not os.path.exists(SCRATCH_PATH):
     print(f"❌ ERROR: Scratch folder not found: {SCRATCH_PATH}")
     exit(1)
 
-def run_simulation(attack, attacker_pps=800, threshold=20, n_nodes=25, window=1.0, sim_time=120):
+def run_simulation(attack, attacker_pps=800, threshold=20, n_nodes=25, window=1.0, sim_time=120, extra="",
+                   area=60, rate_kbps=16):
     """Run a single NS-3 simulation and return results"""
     if attack:
         cmd = (
             f"./ns3 run 'ns3_rpl_dao_mitigation "
             f"--attack=true --attackerPps={attacker_pps} --attackerPkt=120 "
             f"--threshold={threshold} --windowSec={window} --nNodes={n_nodes} "
-            f"--area=60 --rateKbps=16 --simTime={sim_time}'"
+            f"--area={area} --rateKbps={rate_kbps} --simTime={sim_time} {extra}'"
         )
     else:
         cmd = (
             f"./ns3 run 'ns3_rpl_dao_mitigation "
-            f"--attack=false --nNodes={n_nodes} --area=60 "
-            f"--rateKbps=16 --simTime={sim_time}'"
+            f"--attack=false --nNodes={n_nodes} --area={area} "
+            f"--rateKbps={rate_kbps} --simTime={sim_time} {extra}'"
         )
     
     result = subprocess.run(cmd, shell=True, cwd=NS3_PATH, capture_output=True, text=True)
@@ -53,6 +54,7 @@ def run_simulation(attack, attacker_pps=800, threshold=20, n_nodes=25, window=1.
         pdr = pd.read_csv(f"{NS3_PATH}/results/run1_pdr.csv")
         delay = pd.read_csv(f"{NS3_PATH}/results/run1_delay.csv")
         overhead = pd.read_csv(f"{NS3_PATH}/results/run1_overhead.csv")
+        detection = pd.read_csv(f"{NS3_PATH}/results/run1_detection.csv")
         
         return {
             'pdr': pdr['pdr'].values[0],
@@ -62,6 +64,12 @@ def run_simulation(attack, attacker_pps=800, threshold=20, n_nodes=25, window=1.
             'ctrl_tx': overhead['control_tx'].values[0],
             'ctrl_rx': overhead['control_rx'].values[0],
             'ctrl_dropped': overhead['control_dropped'].values[0],
+            'tp': detection['tp'].values[0],
+            'fp': detection['fp'].values[0],
+            'tn': detection['tn'].values[0],
+            'fn': detection['fn'].values[0],
+            'tpr': detection['tpr'].values[0],
+            'fpr': detection['fpr'].values[0],
         }
     except Exception as e:
         print(f"   ❌ Error reading results: {e}")
@@ -101,12 +109,67 @@ def collect_baseline_data():
     
     return pd.DataFrame(scenarios)
 
-def collect_attack_frequency_data():
-    """Vary attack frequency (attacker PPS)"""
+def adaptive_sweep(evaluate, lo, hi, budget, metric='pdr', initial=5, min_step=10, integer=True):
+    """Sample evaluate(x) over [lo, hi] spending at most `budget` runs.
+
+    Starts from `initial` evenly spaced points, then repeatedly bisects the
+    interval whose endpoints differ most in `metric` (relative to the range
+    seen so far, plus a small width term so flat stretches still get a look
+    once the knee is resolved). An interval is only split if both halves
+    stay at least min_step wide, i.e. intervals narrower than 2 * min_step
+    are final.
+    Returns {x: result} for the runs that succeeded.
+    """
+    points = np.linspace(lo, hi, min(initial, budget))
+    results, tried = {}, set()
+    
+    def sample(x):
+        x = int(round(x)) if integer else float(x)
+        if x in tried:
+            return
+        tried.add(x)
+        r = evaluate(x)
+        if r:
+            results[x] = r
+    
+    for x in points:
+        sample(x)
+    while len(tried) < budget:
+        xs = sorted(results)
+        if len(xs) < 2:
+            break
+        ys = np.array([results[x][metric] for x in xs], dtype=float)
+        span = max(ys.max() - ys.min(), 1e-9)
+        best, best_score = None, -1.0
+        for (x0, y0), (x1, y1) in zip(zip(xs, ys), zip(xs[1:], ys[1:])):
+            if x1 - x0 < 2 * min_step:
+                continue
+            score = abs(y1 - y0) / span + 0.1 * (x1 - x0) / (hi - lo)
+            if score > best_score:
+                best, best_score = (x0 + x1) / 2.0, score
+        if best is None:
+            break
+        print(f"   ↳ refining at {best:.0f} (score {best_score:.3f})")
+        before = len(tried)
+        sample(best)
+        if len(tried) == before:
+            break
+    return results
+
+def collect_attack_frequency_data(budget=None):
+    """Vary attack frequency (attacker PPS)
+
+    With a run budget, the attacked scenarios are sampled adaptively over
+    200-1000 pps, refining where PDR changes fastest, instead of on the
+    fixed grid.
+    """
     print("\n" + "="*70)
     print("COLLECTING ATTACK FREQUENCY DATA")
     print("="*70)
     
+    if budget:
+        return collect_adaptive_frequency_data(budget)
+    
     # Attack frequencies in packets per second (similar to paper's intervals)
     frequencies = [200, 400, 600, 800, 1000]
     
@@ -141,6 +204,38 @@ def collect_attack_frequency_data():
     
     return pd.DataFrame(all_data)
 
+def collect_adaptive_frequency_data(budget):
+    """Adaptive PDR-vs-rate sweep; the budget is split over the attacked scenarios"""
+    scenarios = {'InsecRPL': 1000000000, 'SecRPL': 20}
+    # two end points per attacked scenario plus the baseline run
+    min_budget = 2 * len(scenarios) + 1
+    if budget < min_budget:
+        raise ValueError(f"adaptive budget must be at least {min_budget} runs, got {budget}")
+    per_scenario = (budget - 1) // len(scenarios)
+    
+    all_data = []
+    for scenario, thresh in scenarios.items():
+        print(f"▶ {scenario}: adaptive sweep, {per_scenario} runs")
+        runs = adaptive_sweep(lambda pps: run_simulation(attack=True, attacker_pps=pps, threshold=thresh),
+                              200, 1000, per_scenario)
+        for pps, result in runs.items():
+            result['scenario'] = scenario
+            result['attack_pps'] = pps
+            all_data.append(result)
+        print(f"   ✓ Sampled at {sorted(runs)}")
+    
+    # RPL baseline does not depend on the attack rate: one run, replicated
+    frequencies = sorted({r['attack_pps'] for r in all_data})
+    result = run_simulation(attack=False)
+    if result:
+        for pps in frequencies:
+            r = result.copy()
+            r['scenario'] = 'RPL'
+            r['attack_pps'] = pps
+            all_data.append(r)
+    
+    return pd.DataFrame(all_data)
+
 def collect_threshold_data():
     """Vary mitigation threshold (DAOMax)"""
     print("\n" + "="*70)
@@ -162,7 +257,186 @@ def collect_threshold_data():
     
     return pd.DataFrame(all_data)
 
-def create_research_style_graphs(baseline_df, freq_df, thresh_df):
+def collect_roc_data():
+    """Sweep the threshold with honest DAO traffic to trace the detector ROC"""
+    print("\n" + "="*70)
+    print("COLLECTING ROC DATA")
+    print("="*70)
+    
+    # Non-storing DAOs all reach the root detector, so benign packets exist
+    # to be misclassified; a short DAO period makes them frequent.
+    benign = "--rpl=true --mop=nonstoring --daoPeriodSec=2"
+    thresholds = [1, 2, 3, 5, 10, 20, 50, 100, 1000000000]
+    
+    all_data = []
+    for thresh in thresholds:
+        print(f"▶ Testing threshold: {thresh}...")
+        
+        result = run_simulation(attack=True, attacker_pps=800, threshold=thresh, extra=benign)
+        if result:
+            result['threshold'] = thresh
+            all_data.append(result)
+            print(f"   ✓ TPR: {result['tpr']:.3f}  FPR: {result['fpr']:.3f}")
+    
+    return pd.DataFrame(all_data)
+
+def roc_auc(roc_df):
+    """Area under the ROC points, closed at (0,0) and (1,1)"""
+    pts = sorted(zip(roc_df['fpr'], roc_df['tpr']))
+    fpr = np.array([0.0] + [p[0] for p in pts] + [1.0])
+    tpr = np.array([0.0] + [p[1] for p in pts] + [1.0])
+    return float(np.sum(np.diff(fpr) * (tpr[1:] + tpr[:-1]) / 2.0))
+
+# ============= Sensitivity analysis =============
+# Parameter ranges for the sweep designer: (low, high, integer?)
+SENSITIVITY_SPACE = {
+    'n_nodes':      (10, 50, True),
+    'area':         (30.0, 120.0, False),
+    'rate_kbps':    (4.0, 32.0, False),
+    'threshold':    (5, 100, True),
+    'window':       (0.25, 4.0, False),
+    'attacker_pps': (100, 1000, True),
+}
+SENSITIVITY_METRICS = ['pdr', 'delay_ms', 'ctrl_dropped', 'tpr']
+
+def latin_hypercube(n, k, rng):
+    """n points in [0,1)^k, one per stratum in every dimension"""
+    u = (rng.random((n, k)) + np.arange(n)[:, None]) / n
+    for j in range(k):
+        u[:, j] = u[rng.permutation(n), j]
+    return u
+
+def sobol_points(n, k, seed):
+    """Scrambled Sobol points (scipy), falling back to a Latin hypercube"""
+    try:
+        from scipy.stats import qmc
+        return qmc.Sobol(d=k, scramble=True, seed=seed).random(n)
+    except ImportError:
+        print("   ⚠ scipy not available, using a Latin hypercube instead of Sobol")
+        return latin_hypercube(n, k, np.random.default_rng(seed))
+
+def scale_design(unit):
+    """Map unit-cube rows onto SENSITIVITY_SPACE, one dict per run"""
+    rows = []
+    for u in unit:
+        row = {}
+        for (name, (lo, hi, integer)), x in zip(SENSITIVITY_SPACE.items(), u):
+            v = lo + x * (hi - lo)
+            row[name] = int(round(v)) if integer else round(float(v), 3)
+        rows.append(row)
+    return rows
+
+def plan_sensitivity_sweep(n_base=16, design='sobol', seed=1):
+    """Plan the runs for a sensitivity study.
+
+    design='lhs': n_base Latin hypercube runs; main effects only.
+    design='sobol': Saltelli scheme on Sobol points, n_base * (k + 2) runs
+    (matrices A, B and A with column i taken from B); main and total effects.
+    """
+    names = list(SENSITIVITY_SPACE)
+    k = len(names)
+    if design == 'lhs':
+        plan = pd.DataFrame(scale_design(latin_hypercube(n_base, k, np.random.default_rng(seed))))
+        plan['block'] = 'A'
+        plan['base'] = range(n_base)
+        return plan
+    ab = sobol_points(n_base, 2 * k, seed)
+    a, b = ab[:, :k], ab[:, k:]
+    blocks = [('A', a), ('B', b)]
+    for i, name in enumerate(names):
+        abi = a.copy()
+        abi[:, i] = b[:, i]
+        blocks.append((f'AB_{name}', abi))
+    frames = []
+    for label, unit in blocks:
+        df = pd.DataFrame(scale_design(unit))
+        df['block'] = label
+        df['base'] = range(n_base)
+        frames.append(df)
+    return pd.concat(frames, ignore_index=True)
+
+def run_sensitivity_sweep(plan, sim_time=60):
+    """Run every planned point under attack; failed runs are left out"""
+    print("\n" + "="*70)
+    print(f"RUNNING SENSITIVITY SWEEP ({len(plan)} runs)")
+    print("="*70)
+    
+    all_data = []
+    for _, row in plan.iterrows():
+        print(f"▶ {row['block']} #{row['base']}: " +
+              ", ".join(f"{n}={row[n]}" for n in SENSITIVITY_SPACE))
+        result = run_simulation(attack=True, attacker_pps=row['attacker_pps'], threshold=row['threshold'],
+                                n_nodes=row['n_nodes'], window=row['window'], sim_time=sim_time,
+                                area=row['area'], rate_kbps=row['rate_kbps'])
+        if result:
+            result.update(row.to_dict())
+            all_data.append(result)
+    
+    return pd.DataFrame(all_data)
+
+def sensitivity_indices(results, metric='pdr', bins=4):
+    """First-order (S1) and total-effect (ST) indices for one metric.
+
+    Saltelli designs use the Saltelli (2010) S1 and Jansen ST estimators on
+    base rows complete in every block. Plain LHS designs estimate S1 as the
+    variance of binned conditional means; ST is not identifiable there.
+    """
+    names = list(SENSITIVITY_SPACE)
+    rows = []
+    if set(results['block']) == {'A'}:
+        y = results[metric].astype(float)
+        v = y.var()
+        for name in names:
+            cut = pd.qcut(results[name].rank(method='first'), bins, labels=False)
+            s1 = y.groupby(cut).mean().var(ddof=0) / v if v > 0 else np.nan
+            rows.append({'parameter': name, 'metric': metric, 'S1': s1, 'ST': np.nan})
+        return pd.DataFrame(rows)
+    wide = results.pivot_table(index='base', columns='block', values=metric)
+    wide = wide.dropna()
+    fa, fb = wide['A'].values, wide['B'].values
+    v = np.var(np.concatenate([fa, fb]))
+    for name in names:
+        fab = wide[f'AB_{name}'].values
+        s1 = np.mean(fb * (fab - fa)) / v if v > 0 else np.nan
+        st = 0.5 * np.mean((fa - fab) ** 2) / v if v > 0 else np.nan
+        rows.append({'parameter': name, 'metric': metric, 'S1': s1, 'ST': st})
+    return pd.DataFrame(rows)
+
+def plot_sensitivity(indices_df):
+    """Grouped S1 / ST bars per parameter, one panel per metric"""
+    metrics = list(indices_df['metric'].unique())
+    fig, axes = plt.subplots(1, len(metrics), figsize=(5 * len(metrics), 4.5), squeeze=False)
+    for ax, metric in zip(axes[0], metrics):
+        data = indices_df[indices_df['metric'] == metric]
+        x = np.arange(len(data))
+        ax.bar(x - 0.2, data['S1'].values, 0.4, label='Main effect (S1)', color='#2E86AB', edgecolor='black')
+        ax.bar(x + 0.2, data['ST'].fillna(0).values, 0.4, label='Total effect (ST)', color='#F18F01', edgecolor='black')
+        ax.set_xticks(x)
+        ax.set_xticklabels(data['parameter'].values, rotation=30, ha='right')
+        ax.set_title(metric, fontweight='bold')
+        ax.grid(axis='y', alpha=0.3)
+    axes[0][0].set_ylabel('Sensitivity index', fontweight='bold')
+    axes[0][0].legend(loc='best', frameon=True, shadow=True)
+    plt.tight_layout()
+    plt.savefig(f'{RESULTS_DIR}/figure8_sensitivity.png', dpi=300, bbox_inches='tight')
+    print("✓ Saved: figure8_sensitivity.png")
+    plt.close()
+
+def sensitivity_main(n_base, design):
+    plan = plan_sensitivity_sweep(n_base, design)
+    plan.to_csv(f'{RESULTS_DIR}/sensitivity_plan.csv', index=False)
+    results = run_sensitivity_sweep(plan)
+    results.to_csv(f'{RESULTS_DIR}/sensitivity_data.csv', index=False)
+    if results.empty:
+        print("❌ No successful runs")
+        return
+    indices = pd.concat([sensitivity_indices(results, m) for m in SENSITIVITY_METRICS], ignore_index=True)
+    indices.to_csv(f'{RESULTS_DIR}/sensitivity_indices.csv', index=False)
+    print("\n📊 Sensitivity indices:")
+    print(indices.to_string(index=False))
+    plot_sensitivity(indices)
+
+def create_research_style_graphs(baseline_df, freq_df, thresh_df, roc_df=pd.DataFrame()):
     """Create publication-quality graphs matching the research paper style"""
     
     # Set publication style
@@ -361,8 +635,33 @@ def create_research_style_graphs(baseline_df, freq_df, thresh_df):
         plt.savefig(f'{RESULTS_DIR}/figure6_comparison.png', dpi=300, bbox_inches='tight')
         print("✓ Saved: figure6_comparison.png")
         plt.close()
+    
+    # ============= GRAPH 7: Detector ROC over thresholds =============
+    if not roc_df.empty:
+        fig, ax = plt.subplots(figsize=(6, 6))
+        
+        data = roc_df.sort_values('fpr')
+        ax.plot(data['fpr'].values, data['tpr'].values,
+               marker='o', linewidth=2, markersize=8,
+               label=f'SecRPL (AUC = {roc_auc(roc_df):.3f})', color=colors['SecRPL'])
+        for _, row in data.iterrows():
+            ax.annotate(f"{int(row['threshold'])}" if row['threshold'] < 1e6 else "off",
+                       (row['fpr'], row['tpr']), textcoords='offset points', xytext=(5, -10), fontsize=8)
+        ax.plot([0, 1], [0, 1], color='gray', linestyle=':', linewidth=1)
+        
+        ax.set_xlabel('False Positive Rate', fontweight='bold')
+        ax.set_ylabel('True Positive Rate', fontweight='bold')
+        ax.set_title('Detector ROC across DAO Thresholds', fontweight='bold')
+        ax.set_xlim([-0.02, 1.02])
+        ax.set_ylim([-0.02, 1.02])
+        ax.legend(loc='lower right', frameon=True, shadow=True)
+        ax.grid(True, alpha=0.3, linestyle='--')
+        plt.tight_layout()
+        plt.savefig(f'{RESULTS_DIR}/figure7_roc.png', dpi=300, bbox_inches='tight')
+        print("✓ Saved: figure7_roc.png")
+        plt.close()
 
-def print_summary_table(baseline_df, freq_df, thresh_df):
+def print_summary_table(baseline_df, freq_df, thresh_df, roc_df=pd.DataFrame()):
     """Print summary statistics"""
     print("\n" + "="*80)
     print("SUMMARY STATISTICS")
@@ -383,8 +682,13 @@ def print_summary_table(baseline_df, freq_df, thresh_df):
             
             blocked = baseline_df[baseline_df['scenario'] == 'SecRPL']['ctrl_dropped'].values[0]
             print(f"   • Malicious Packets Blocked: {int(blocked)}")
+    
+    if not roc_df.empty:
+        print("\n🎯 Detection Accuracy (confusion matrix per threshold):")
+        print(roc_df[['threshold', 'tp', 'fp', 'tn', 'fn', 'tpr', 'fpr']].to_string(index=False))
+        print(f"   • ROC AUC: {roc_auc(roc_df):.3f}")
 
-def main():
+def main(adaptive_budget=None):
     print("\n" + "🚀 " + "="*76 + " 🚀")
     print("   NS-3 RPL DAO ATTACK ANALYSIS - RESEARCH PAPER STYLE")
     print("🚀 " + "="*76 + " 🚀\n")
@@ -406,24 +710,26 @@ def main():
     
     # Collect all data
     baseline_df = collect_baseline_data()
-    freq_df = collect_attack_frequency_data()
+    freq_df = collect_attack_frequency_data(adaptive_budget)
     thresh_df = collect_threshold_data()
+    roc_df = collect_roc_data()
     
     # Save raw data
     baseline_df.to_csv(f'{RESULTS_DIR}/baseline_data.csv', index=False)
     freq_df.to_csv(f'{RESULTS_DIR}/frequency_data.csv', index=False)
     thresh_df.to_csv(f'{RESULTS_DIR}/threshold_data.csv', index=False)
+    roc_df.to_csv(f'{RESULTS_DIR}/roc_data.csv', index=False)
     print(f"\n💾 Saved raw data to {RESULTS_DIR}/")
     
     # Generate graphs
     print("\n📊 Generating publication-quality graphs...")
-    create_research_style_graphs(baseline_df, freq_df, thresh_df)
+    create_research_style_graphs(baseline_df, freq_df, thresh_df, roc_df)
     
     # Print summary
-    print_summary_table(baseline_df, freq_df, thresh_df)
+    print_summary_table(baseline_df, freq_df, thresh_df, roc_df)
     
     print("\n" + "✅ " + "="*76 + " ✅")
-    print(f"   ANALYSIS COMPLETE! Generated 6 figures in {RESULTS_DIR}/")
+    print(f"   ANALYSIS COMPLETE! Generated 7 figures in {RESULTS_DIR}/")
     print("✅ " + "="*76 + " ✅\n")
     
     print("📈 Generated Figures:")
@@ -432,7 +738,22 @@ def main():
     print("   3. figure3_delay_vs_frequency.png - Delay vs attack frequency")
     print("   4. figure4_pdr_vs_threshold.png - PDR vs threshold parameter")
     print("   5. figure5_overhead_vs_threshold.png - Overhead vs threshold")
-    print("   6. figure6_comparison.png - Overall performance comparison\n")
+    print("   6. figure6_comparison.png - Overall performance comparison")
+    print("   7. figure7_roc.png - Detector ROC across thresholds\n")
 
 if __name__ == "__main__":
-    main()
+    import argparse
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--sensitivity', type=int, metavar='N',
+                        help='run a sensitivity study with N base points instead of the paper figures')
+    parser.add_argument('--adaptive', type=int, metavar='RUNS',
+                        help='sample the attack-rate sweep adaptively within this many runs')
+    parser.add_argument('--design', choices=['sobol', 'lhs'], default='sobol',
+                        help='sobol: N*(k+2) runs, main and total effects; lhs: N runs, main effects')
+    args = parser.parse_args()
+    if args.adaptive is not None and args.adaptive < 5:
+        parser.error('--adaptive needs at least 5 runs (2 per attacked scenario plus the baseline)')
+    if args.sensitivity:
+        sensitivity_main(args.sensitivity, args.design)
+    else:
+        main(args.adaptive)